@@ -0,0 +1,6 @@
+// The compiled part of the BasicLog library, see BASIC_LOG_COMPILED_LIB in
+// basic_log.h. Without that macro everything here is inline in basic_log.h
+// already, and the file compiles to nothing.
+
+#include "basic_log.h"
+#include "basic_log_inl.h"
@@ -1,19 +1,68 @@
 #ifndef BASIC_LOG_H
 #define BASIC_LOG_H
 
+#include <algorithm>
 #include <atomic>
+#include <charconv>
 #include <chrono>
-#include <ctime>
-#include <iomanip>
-#include <iostream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
-#include <sstream>
 #include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <vector>
 
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#endif
+
+#include "basic_log_binary.h"
+#include "basic_log_buffer.h"
+#include "basic_log_context.h"
+#include "basic_log_dedup.h"
+#include "basic_log_prefix.h"
+#include "basic_log_rate_limit.h"
+#include "basic_log_structured.h"
+#include "basic_log_time.h"
+#include "basic_log_traits.h"
+
+// Only named by Logging. The engine's headers, the sinks and the std headers
+// only they need come with basic_log_inl.h.
+namespace basic_log {
+namespace detail {
+class VModule;
+}  // namespace detail
+}  // namespace basic_log
+
+/**
+ * * @brief Log statements below this level are compiled out.
+ * * @details 0 to 4 for DEBUG to FATAL. Usually set through the CMake cache
+ * variable of the same name.
+ */
+#ifndef BASIC_LOG_MIN_LEVEL
+#define BASIC_LOG_MIN_LEVEL 0
+#endif
+
+/**
+ * * @brief Marks the definitions of basic_log_inl.h.
+ * * @details Without BASIC_LOG_COMPILED_LIB the library is header-only and
+ * they are inline. With it, which the BASIC_LOG_COMPILED_LIB CMake option
+ * defines for the BasicLog target and its users, basic_log.h only keeps
+ * what the LOG statements run inline, and the rest is compiled once into
+ * the library.
+ */
+#ifdef BASIC_LOG_COMPILED_LIB
+#define BASIC_LOG_INLINE
+#else
+#define BASIC_LOG_INLINE inline
+#endif
+
 /**
  * * @brief A simple logging class that supports different log levels.
  * * @details This class provides a way to log messages with different severity
@@ -21,7 +70,9 @@
  * dynamically, and messages below the current level will not be logged.
  * * @note The logging level can be set using the BasicConfig method. The
  * default level is DEBUG. The logging messages are printed to standard error
- * output.
+ * output unless other sinks are registered through BasicConfig. They are
+ * written either on the calling thread or, when the asynchronous mode is
+ * enabled, by a dedicated writer thread.
  * * @example
  * * #include "basic_log.h"
  * * int main(int argc, char const *argv[])
@@ -43,19 +94,222 @@ class Logging {
  public:
   /**
    * * @brief Enumeration for log levels.
+   * * @details Logging a FATAL record flushes everything logged so far, the
+   * record included, and then aborts the process.
    */
   enum LogLevel { DEBUG, INFO, WARN, ERROR, FATAL };
 
-  Logging() = default;
+  /**
+   * * @brief What an asynchronous producer does when the ring is full.
+   * * @details BLOCK waits for the writer to make room, DROP_NEWEST discards
+   * the record being logged and DROP_OLDEST discards the oldest queued record
+   * to make room for it. Dropped records are counted, see GetDroppedCount.
+   */
+  enum class OverflowPolicy { BLOCK, DROP_NEWEST, DROP_OLDEST };
+
+  /**
+   * * @brief Settings of the asynchronous mode.
+   * * @details When enabled, the destructor pushes the finished record into a
+   * bounded lock-free ring and returns; a writer thread drains the ring and
+   * writes up to max_batch records per output call. With per_thread_queues
+   * the DROP_OLDEST policy behaves like DROP_NEWEST, since only the writer
+   * removes records from a thread's queue.
+   */
+  struct AsyncOptions {
+    bool enabled{false};
+    size_t capacity{8192};
+    OverflowPolicy overflow_policy{OverflowPolicy::BLOCK};
+    size_t max_batch{256};
+    /// @brief Give every logging thread a queue of its own instead of
+    /// sharing one ring; capacity is then only used during thread exit.
+    bool per_thread_queues{false};
+    /// @brief Capacity of each per-thread queue.
+    size_t thread_capacity{1024};
+    /// @brief With per_thread_queues, write the records the writer drains
+    /// together in timestamp order rather than queue by queue.
+    bool strict_ordering{false};
+  };
+
+  /**
+   * * @brief Resolution of the timestamp in the record prefix.
+   */
+  enum class TimestampPrecision { SECONDS, MILLISECONDS, MICROSECONDS };
+
+  /**
+   * * @brief The clock records are stamped with: REALTIME, REALTIME_COARSE,
+   * TSC or STEADY; see basic_log::detail::ClockSource.
+   */
+  using ClockSource = basic_log::detail::ClockSource;
+
+  /**
+   * * @brief How records are encoded for the sinks.
+   * * @details TEXT formats every record into a line. BINARY only stores the
+   * call site ID, the timestamp and the raw bytes of the streamed values, and
+   * leaves the formatting to BasicLogDecode; see basic_log_binary.h. Each
+   * call site is described once per BasicConfig call, so the decoder needs
+   * every file written since then, e.g. all rotated segments.
+   *
+   * JSON writes one object per line with the members "time", "level",
+   * "file", "line", the fields attached with With and "msg", the streamed
+   * values as text. LOGFMT writes the same as key=value pairs.
+   */
+  enum class Format { TEXT, BINARY, JSON, LOGFMT };
+
+  /**
+   * * @brief A finished record as handed to the sinks.
+   */
+  struct Record {
+    LogLevel level;
+    /// @brief The formatted line, including the trailing newline.
+    std::string_view text;
+  };
+
+  class Sink;
+  class ConsoleSink;
+  class FileSink;
+  class MmapSink;
+  class NetworkSink;
+  class ScopedContext;
+  class Context;
+  class ContextScope;
+#ifdef __cpp_impl_coroutine
+  template <typename Awaitable>
+  class ContextAwaiter;
+#endif
+
+  /**
+   * * @brief Everything BasicConfig can set in one call.
+   */
+  struct Options {
+    LogLevel level{DEBUG};
+    TimestampPrecision timestamp_precision{TimestampPrecision::SECONDS};
+    /// @brief TSC calibrates for 10 ms in BasicConfig. REALTIME_COARSE is
+    /// only as fine as the kernel's timer tick.
+    ClockSource clock_source{ClockSource::REALTIME};
+    Format format{Format::TEXT};
+    /// @brief Significant digits of floating-point values, or -1 for the
+    /// shortest text that reads back as the same value. Capped at 30.
+    int float_precision{6};
+    /// @brief Elements written of each container, nested ones included,
+    /// before the rest is elided as "...(N more)"; 0 for no limit.
+    size_t max_container_elements{1000};
+    /// @brief Bytes a container may take up in a record before the rest of
+    /// its elements is elided; 0 for no limit.
+    size_t max_container_bytes{64 * 1024};
+    AsyncOptions async;
+    /// @brief Per-file level overrides, e.g. "net/*=DEBUG,db=WARN"; see
+    /// SetVModule.
+    std::string vmodule;
+    /// @brief Where records go; a ConsoleSink if empty.
+    std::vector<std::shared_ptr<Sink>> sinks;
+    /// @brief Fill the latency histograms of GetStats. Costs two clock
+    /// reads per enqueue and per sink write.
+    bool latency_stats{false};
+    /**
+     * * @brief Count instead of write a record that repeats the last one
+     * its LOG statement wrote, within this time from it; 0 to write all.
+     * * @details The next record written by the statement, or Flush, first
+     * writes "last message repeated N times" at the statement's level.
+     * FATAL records are always written.
+     */
+    std::chrono::milliseconds dedup_window{0};
+  };
+
+  /**
+   * * @brief The logger's own counters, see GetStats.
+   */
+  struct Stats {
+    static constexpr size_t kLevels = 5;
+    static constexpr size_t kLatencyBuckets = 32;
+
+    /**
+     * * @brief Exclusive upper bound of latency bucket i, in nanoseconds.
+     * * @details Bucket 0 counts zero latencies, bucket i those from
+     * 2^(i-1) up to 2^i; the last bucket has no upper bound.
+     */
+    static constexpr uint64_t BucketLimit(size_t i) { return uint64_t{1} << i; }
+
+    /// @brief Records logged, by level.
+    uint64_t records[kLevels]{};
+    /// @brief Records discarded by the overflow policy, by level.
+    uint64_t dropped[kLevels]{};
+    /// @brief Records counted instead of written, see Options::dedup_window.
+    uint64_t suppressed[kLevels]{};
+    /// @brief Bytes handed to the sinks, counted once per sink.
+    uint64_t bytes_written{0};
+    /// @brief Calls of Sink::Flush.
+    uint64_t flushes{0};
+    /// @brief The most records the writer thread found queued at once.
+    uint64_t queue_high_water{0};
+    /// @brief Time a producer spent handing a record to the writer thread.
+    uint64_t enqueue_latency[kLatencyBuckets]{};
+    /// @brief Time of each Sink::Write call.
+    uint64_t sink_write_latency[kLatencyBuckets]{};
+  };
+
+  /**
+   * * @brief A LOG statement, known at compile time.
+   * * @details The LOG macros keep one constant-initialized Site per
+   * statement. Text records copy its prefix, rendered at compile time; the
+   * binary format refers to it by id instead of repeating the file name and
+   * the line in every record.
+   */
+  struct Site {
+    LogLevel level;
+    std::string_view level_str;
+    std::string_view file;
+    int line;
+    /// @brief "[LEVEL][", see detail::SitePrefix.
+    std::string_view head;
+    /// @brief "][file:line]:".
+    std::string_view tail;
+    /// @brief Binary site ID; 0 until the site is first logged in binary.
+    std::atomic<uint32_t> id{0};
+    /// @brief The configuration generation the site was last described in.
+    std::atomic<uint32_t> described_in{0};
+    /// @brief See Options::dedup_window.
+    basic_log::detail::Repeats repeats;
+    /// @brief The next site on the list of repeating_sites.
+    Site* next_repeating{nullptr};
+  };
+
+  explicit Logging(Site& site)
+      : level(site.level),
+        site(&site),
+        context(basic_log::detail::ThreadFormatContexts::Acquire()) {
+    Format format = record_format.load(std::memory_order_relaxed);
+    if (format == Format::TEXT) {
+      BeginText(site.head, site.tail);
+    } else if (format == Format::BINARY) {
+      BeginBinary(SiteId(site), site);
+    } else {
+      BeginStructured(format, site.level_str, site.file, site.line);
+    }
+    body_start = context->buffer.size();
+    AppendContext(format);
+  }
 
   Logging(std::string_view level_str, std::string_view file, int line)
-      : oss(std::ostringstream()) {
-    *oss << "[" << level_str << "]";
-    // Get current time
-    std::time_t now = std::time(nullptr);
-    std::tm* local_time = std::localtime(&now);
-    *oss << std::put_time(local_time, "[%Y-%m-%d %H:%M:%S]");
-    *oss << "[" << file << ":" << line << "]:";
+      : Logging(ParseLevel(level_str), level_str, file, line) {}
+
+  Logging(LogLevel level, std::string_view level_str, std::string_view file,
+          int line)
+      : level(level),
+        context(basic_log::detail::ThreadFormatContexts::Acquire()) {
+    if (BASIC_LOG_STRIP_PATH) {
+      file = basic_log::detail::Basename(file);
+    }
+    Format format = record_format.load(std::memory_order_relaxed);
+    if (format == Format::TEXT) {
+      BeginText(level_str, file, line);
+    } else if (format == Format::BINARY) {
+      // No Site to refer to: the record describes its site inline.
+      Site site{level, level_str, file, line, {}, {}, {}, {}, {}, nullptr};
+      BeginBinary(0, site);
+    } else {
+      BeginStructured(format, level_str, file, line);
+    }
+    AppendContext(format);
   }
 
   Logging& operator<<(void (*manip)(Logging&)) {
@@ -65,59 +319,227 @@ class Logging {
 
   static void NoSpace(Logging& log) { log.no_space = true; }
 
-  template <typename T>
+  /**
+   * * @brief The record as an lvalue, so that the free operator<< overloads
+   * also apply to the first streamed value.
+   */
+  Logging& Self() { return *this; }
+
+  /**
+   * * @brief Turns a streaming expression into void for the LOG macros.
+   * * @details operator& binds looser than operator<< and tighter than ?:, so
+   * "cond ? (void)0 : Voidify() & Logging(...) << a << b" streams everything
+   * into the record and both branches have type void.
+   */
+  struct Voidify {
+    void operator&(const Logging&) const {}
+  };
+
+  /**
+   * * @brief Append a value to the record.
+   * * @details Numbers are formatted with std::to_chars and strings, bools
+   * and characters are copied directly; everything else goes through the
+   * std::ostream of the record, as does every value once a manipulator has
+   * changed the stream's formatting. Ranges and tuples without a
+   * std::ostream operator<< of their own go to the container overloads.
+   */
+  template <typename T,
+            typename = std::enable_if_t<
+                !basic_log::detail::kFormatsAsRange<T> &&
+                !basic_log::detail::kFormatsAsTuple<T>>>
   Logging& operator<<(const T& value) {
-    if (oss) {
-      if (no_space) {
-        no_space = false;
-      } else {
-        *oss << " ";
-      }
-      *oss << value;
+    bool space = TakeSpace();
+    if (encoding != Encoding::TEXT) {
+      Encode(space, value);
+      return *this;
     }
+    if (space) {
+      context->buffer.Append(' ');
+    }
+    AppendText(value);
     return *this;
   }
 
-  template <typename T>
-  Logging& LogSequence(std::string_view name, T begin, T end) {
-    *this << name << NoSpace << "{";
-    for (auto it = begin; it != end; ++it) {
-      *this << *it;
-      if (std::next(it) != end) {
-        *this << ",";
-      }
+  Logging& operator<<(basic_log::detail::Literal literal) {
+    bool space = TakeSpace();
+    auto& buffer = context->buffer;
+    switch (encoding) {
+      case Encoding::TEXT:
+        break;
+      case Encoding::BINARY:
+        basic_log::detail::BinaryWriter::PutTag(
+            buffer, basic_log::detail::ValueTag::LITERAL, space);
+        basic_log::detail::BinaryWriter::Put(buffer,
+                                             static_cast<uint8_t>(literal));
+        return *this;
+      case Encoding::MESSAGE:
+        OpenMessage(space);
+        buffer.Append(
+            basic_log::detail::kLiterals[static_cast<size_t>(literal)]);
+        return *this;
+      case Encoding::FIELD:
+        EncodeField(literal);
+        return *this;
+    }
+    if (space) {
+      buffer.Append(' ');
+    }
+    buffer.Append(basic_log::detail::kLiterals[static_cast<size_t>(literal)]);
+    return *this;
+  }
+
+  Logging& operator<<(basic_log::detail::DurationValue value) {
+    if (encoding == Encoding::BINARY) {
+      auto& buffer = context->buffer;
+      basic_log::detail::BinaryWriter::PutTag(
+          buffer, basic_log::detail::ValueTag::DURATION, TakeSpace());
+      basic_log::detail::BinaryWriter::Put(buffer, value.count);
+      basic_log::detail::BinaryWriter::Put(buffer,
+                                           static_cast<uint8_t>(value.unit));
+      return *this;
+    }
+    std::string_view unit =
+        basic_log::detail::kDurationUnits[static_cast<size_t>(value.unit)];
+    if (encoding == Encoding::FIELD) {
+      // A string, so that the unit is kept.
+      TakeSpace();
+      auto& buffer = context->buffer;
+      buffer.Append('"');
+      char* out = buffer.Reserve(basic_log::detail::kMaxNumberLength);
+      buffer.Commit(basic_log::detail::FormatInteger(out, value.count));
+      buffer.Append(' ');
+      buffer.Append(unit);
+      buffer.Append('"');
+      return *this;
+    }
+    return *this << value.count << unit;
+  }
+
+  /// @brief The "...(N more)" that ends an elided container.
+  Logging& operator<<(basic_log::detail::ElidedValue value) {
+    char text[basic_log::detail::kMaxNumberLength + 16];
+    std::memcpy(text, "...(", 4);
+    size_t length = 4 + basic_log::detail::FormatInteger(text + 4, value.count);
+    std::memcpy(text + length, " more)", 6);
+    length += 6;
+    if (encoding != Encoding::FIELD) {
+      return *this << std::string_view(text, length);
+    }
+    TakeSpace();
+    auto& buffer = context->buffer;
+    buffer.Append('"');
+    buffer.Append(text, length);
+    buffer.Append('"');
+    if (nesting.expecting_key) {
+      // Stands in for a member of an object.
+      buffer.Append(":null");
+      nesting.expecting_key = false;
     }
-    *this << "}";
     return *this;
   }
 
+  Logging& operator<<(basic_log::detail::TimePointValue value);
+
+  /**
+   * * @brief Attach a typed field to the record.
+   * * @details JSON and LOGFMT records encode it as a member of their own:
+   * numbers, bools and strings keep their type, standard containers become
+   * arrays and objects, nullopt and nullptr become null and anything else is
+   * stored as its text. TEXT and BINARY records show it as key=value among
+   * the streamed values.
+   * * @note Fields go before "msg" even if they are attached after values
+   * were streamed.
+   */
   template <typename T>
-  Logging& LogMapping(std::string_view name, T begin, T end) {
-    *this << name << NoSpace << "{";
-    for (auto it = begin; it != end; ++it) {
-      *this << it->first << ":" << it->second;
-      if (std::next(it) != end) {
-        *this << ",";
-      }
+  Logging& With(basic_log::detail::FieldKey key, const T& value) {
+    if (encoding == Encoding::TEXT || encoding == Encoding::BINARY) {
+      return *this << key.name << NoSpace << basic_log::detail::Literal::EQUALS
+                   << NoSpace << value;
+    }
+    auto& buffer = context->buffer;
+    size_t start = buffer.size();
+    AppendKey(key);
+    size_t value_start = buffer.size();
+    encoding = Encoding::FIELD;
+    nesting = {};
+    *this << value;
+    encoding = Encoding::MESSAGE;
+    no_space = false;
+    if (logfmt) {
+      FinishLogfmtValue(value_start);
+    }
+    if (message_open) {
+      char* data = buffer.data();
+      std::rotate(data + message_start, data + start, data + buffer.size());
+      message_start += buffer.size() - start;
     }
-    *this << "}";
     return *this;
   }
 
+  /// @brief size argument of LogSequence and LogMapping if it is not known.
+  static constexpr size_t kUnknownSize = static_cast<size_t>(-1);
+
+  /**
+   * * @brief Append the elements of [begin, end) as "name{ a , b }".
+   * * @details Once Options::max_container_elements elements or
+   * Options::max_container_bytes bytes are written, the rest is elided as
+   * "...(N more)".
+   * * @param size The number of elements, if known; spares counting those
+   * elided unless T is random access.
+   */
+  template <typename T>
+  Logging& LogSequence(std::string_view name, T begin, T end,
+                       size_t size = kUnknownSize) {
+    OpenNamed(name, basic_log::detail::Literal::VECTOR_OPEN);
+    return LogElements(begin, end, size);
+  }
+
+  /// @brief LogSequence for the standard containers, opened by a Literal.
+  template <typename T>
+  Logging& LogSequence(basic_log::detail::Literal open, T begin, T end,
+                       size_t size = kUnknownSize) {
+    *this << open;
+    return LogElements(begin, end, size);
+  }
+
+  /// @brief Like LogSequence, for elements with first and second.
+  template <typename T>
+  Logging& LogMapping(std::string_view name, T begin, T end,
+                      size_t size = kUnknownSize) {
+    OpenNamed(name, basic_log::detail::Literal::MAP_OPEN);
+    return LogPairs(begin, end, size);
+  }
+
+  /// @brief LogMapping for the standard containers, opened by a Literal.
+  template <typename T>
+  Logging& LogMapping(basic_log::detail::Literal open, T begin, T end,
+                      size_t size = kUnknownSize) {
+    *this << open;
+    return LogPairs(begin, end, size);
+  }
+
+  /**
+   * * @brief Append the members of a tuple-like value, i.e. one that
+   * std::tuple_size and get<I> apply to, as "name{ a , b }".
+   */
+  template <typename T>
+  Logging& LogTuple(std::string_view name, const T& value) {
+    OpenNamed(name, basic_log::detail::Literal::VECTOR_OPEN);
+    LogMembers(value, std::make_index_sequence<std::tuple_size_v<T>>());
+    return *this << basic_log::detail::Literal::CLOSE;
+  }
+
   /**
    * * @brief Destructor for the Logging class.
    * * @details The destructor checks the current logging level and prints the
    * log message if the level is higher than or equal to the current level.
+   * In the asynchronous mode the message is handed to the writer thread
+   * instead of being printed on the calling thread.
    * * @note The destructor is called when the Logging object goes out of
    * scope. It ensures that the log message is printed even if the object is
    * destroyed.
    */
-  ~Logging() {
-    if (!oss) {
-      return;
-    }
-    std::cerr << oss->str() << std::endl;
-  }
+  ~Logging();
 
   // Prevent copying
   Logging(const Logging&) = delete;
@@ -136,90 +558,1123 @@ class Logging {
    * change the logging level at runtime.
    */
   static void BasicConfig(LogLevel level) {
-    // Set the logging level here if needed
     current_level = level;
+    InvalidateLevels();
   }
   static LogLevel GetCurrentLevel() { return current_level; }
 
+  /// @brief The compile-time floor, see BASIC_LOG_MIN_LEVEL.
+  static constexpr LogLevel kMinLevel =
+      static_cast<LogLevel>(BASIC_LOG_MIN_LEVEL);
+
+  /**
+   * * @brief Whether statements of this level are compiled in at all.
+   * * @note A variable template rather than a constexpr function, so that the
+   * LOG macros fold it away even without optimization.
+   */
+  template <LogLevel level>
+  static constexpr bool kCompiledIn = level >= kMinLevel;
+
+  /**
+   * * @brief Whether a record of this level passes the runtime level,
+   * regardless of the vmodule overrides.
+   */
+  static bool IsEnabled(LogLevel level) {
+    return level >= current_level.load(std::memory_order_relaxed);
+  }
+
+  /// @brief The initial value of a statement's level cache.
+  static constexpr int kLevelUnresolved = -1;
+
+  /**
+   * * @brief Whether a statement of this level in file passes the runtime
+   * level and the vmodule overrides.
+   * * @param cache The statement's own minimum level, kLevelUnresolved at
+   * first. It is resolved against the overrides once per configuration, so
+   * the common case is a single relaxed load and compare.
+   */
+  static bool IsEnabled(LogLevel level, std::atomic<int>& cache,
+                        const char* file) {
+    int min_level = cache.load(std::memory_order_relaxed);
+    if (level < min_level) {
+      return false;
+    }
+    return min_level >= 0 || level >= ResolveLevel(cache, file);
+  }
+
+  /**
+   * * @brief Override the level of some source files.
+   * * @details spec is a comma-separated list of pattern=LEVEL. A pattern is
+   * matched against the file name without the extension, or against its
+   * trailing path components if it contains a '/'; '*' and '?' are
+   * wildcards. The first matching pattern wins, other files use the level
+   * set by BasicConfig. An empty spec removes all overrides.
+   * * @throws std::invalid_argument if spec is malformed; the overrides in
+   * effect are kept then.
+   */
+  static void SetVModule(std::string_view spec);
+
+  /**
+   * * @brief Set the logging level, the sinks and the output mode.
+   * * @details Enabling options.async starts a writer thread; disabling it
+   * stops the running one after it has written everything already queued.
+   * Safe to call while other threads log: they keep using the previous
+   * sinks and writer until they pick up the new ones, after which the
+   * previous writer writes everything still queued and the previous sinks
+   * are flushed and released.
+   * * @note Must not be called from a sink. Records still queued for the
+   * previous writer may reach a sink that is kept after newer ones.
+   */
+  static void BasicConfig(const Options& options);
+
+  static Format GetFormat() {
+    return record_format.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * * @brief Block until every record logged so far has been written and
+   * flushed by the sinks.
+   * * @details Repeats counted by Options::dedup_window are reported first.
+   */
+  static void Flush();
+
+  /**
+   * * @brief Install handlers for SIGSEGV, SIGABRT and SIGBUS that write out
+   * the records buffered or queued in memory before the process dies.
+   * * @details The handlers only make async-signal-safe calls: every sink's
+   * EmergencyFlush, then EmergencyWrite of the sinks served by the writer
+   * thread for each record still queued for it. They then restore the
+   * previous handler and raise the signal again, so core dumps and other
+   * handlers keep working. Nothing is locked, so this is best effort; the
+   * batch the writer thread is writing at the time may be lost.
+   * * @note Call it once the handlers it should chain to are installed.
+   * Calling it again has no effect.
+   */
+  static void InstallCrashHandlers();
+
+  /**
+   * * @brief Number of records discarded by the overflow policy.
+   */
+  static uint64_t GetDroppedCount() {
+    return dropped_records.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * * @brief The logger's own counters, summed over all threads, including
+   * those that have exited.
+   * * @details Each thread counts into a shard of its own, so counting adds
+   * no writes to shared cache lines; GetStats takes a lock and sums the
+   * shards. The latency histograms stay empty unless
+   * Options::latency_stats is set.
+   */
+  static Stats GetStats();
+
+  /**
+   * * @brief function, wrapped to run with the fields of the scoped contexts
+   * open on the calling thread now, on whichever thread calls it later.
+   * * @details The integration point for executors: posting
+   * BindContext(task) instead of task makes the records of the task carry
+   * the context it was posted from. See Context.
+   */
+  template <typename F>
+  static auto BindContext(F function);
+
+#ifdef __cpp_impl_coroutine
+  /**
+   * * @brief awaitable, wrapped so that the coroutine resumes with the
+   * fields it had when it suspended; see ContextAwaiter.
+   * * @details "co_await Logging::KeepContext(socket.Read(buffer));"
+   */
+  template <typename Awaitable>
+  static ContextAwaiter<Awaitable> KeepContext(Awaitable&& awaitable);
+#endif
+
  private:
+  class AsyncWriter;
+  class FlushTimer;
+  class StatsShard;
+  struct Config;
+  struct Engine;
+
+  static constexpr std::string_view kLevelNames[] = {"DEBUG", "INFO", "WARN",
+                                                     "ERROR", "FATAL"};
+  static_assert(std::size(kLevelNames) == Stats::kLevels);
+
+  static LogLevel ParseLevel(std::string_view level_str) {
+    for (int i = 0; i < 5; ++i) {
+      if (kLevelNames[i] == level_str) {
+        return static_cast<LogLevel>(i);
+      }
+    }
+    return INFO;
+  }
+
+  static_assert(basic_log::detail::ContextStack::kFormats ==
+                static_cast<size_t>(Format::LOGFMT) + 1);
+
+  /// @brief Tag of the constructor that formats a ScopedContext field.
+  struct ContextField {};
+
+  /**
+   * * @brief Format a field the way records of format contain it, see
+   * ScopedContext; nothing is written when it is destroyed.
+   */
+  Logging(Format format, ContextField)
+      : level(DEBUG),
+        field_only(true),
+        context(basic_log::detail::ThreadFormatContexts::Acquire()) {
+    if (format == Format::BINARY) {
+      encoding = Encoding::BINARY;
+    } else if (format != Format::TEXT) {
+      encoding = Encoding::MESSAGE;
+      logfmt = format == Format::LOGFMT;
+    }
+  }
+
+  /// @brief Append the fields of the scoped contexts open on this thread.
+  void AppendContext(Format format) {
+    context->buffer.Append(basic_log::detail::ContextStack::Local().Fields(
+        static_cast<size_t>(format)));
+  }
+
+  /// @brief Which sinks a call to WriteToSinks addresses.
+  enum class SinkGroup { ALL, THREAD_SAFE, SERIALIZED };
+
+  /// @brief Start a text record with a prefix rendered at compile time.
+  void BeginText(std::string_view head, std::string_view tail) {
+    auto& buffer = context->buffer;
+    buffer.Append(head);
+    time = basic_log::detail::WallClock::Now();
+    char* out = buffer.Reserve(basic_log::detail::TimestampCache::kMaxLength);
+    buffer.Commit(basic_log::detail::TimestampCache::Format(
+        time, fraction_digits.load(std::memory_order_relaxed), out));
+    buffer.Append(tail);
+  }
+
+  void BeginText(std::string_view level_str, std::string_view file,
+                 int line) {
+    auto& buffer = context->buffer;
+    buffer.Append('[');
+    buffer.Append(level_str);
+    buffer.Append("][");
+    time = basic_log::detail::WallClock::Now();
+    char* out = buffer.Reserve(basic_log::detail::TimestampCache::kMaxLength);
+    buffer.Commit(basic_log::detail::TimestampCache::Format(
+        time, fraction_digits.load(std::memory_order_relaxed), out));
+    buffer.Append("][");
+    buffer.Append(file);
+    buffer.Append(':');
+    out = buffer.Reserve(16);
+    buffer.Commit(std::to_chars(out, out + 16, line).ptr - out);
+    buffer.Append("]:");
+  }
+
+  /// @param id The site ID, or 0 to describe site inline.
+  void BeginBinary(uint32_t id, const Site& site) {
+    using basic_log::detail::BinaryWriter;
+    encoding = Encoding::BINARY;
+    auto& buffer = context->buffer;
+    time = basic_log::detail::WallClock::Now();
+    BinaryWriter::BeginFrame(buffer, basic_log::detail::FrameKind::EVENT);
+    BinaryWriter::Put(buffer, id);
+    BinaryWriter::Put(buffer,
+                      static_cast<int64_t>(
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              time.time_since_epoch())
+                              .count()));
+    BinaryWriter::Put(buffer, static_cast<uint8_t>(fraction_digits.load(
+                                  std::memory_order_relaxed)));
+    BinaryWriter::Put(buffer, static_cast<int8_t>(float_precision.load(
+                                  std::memory_order_relaxed)));
+    if (id == 0) {
+      PutSite(buffer, site);
+    }
+  }
+
+  /// @brief Start a JSON or LOGFMT record with its prefix fields.
+  void BeginStructured(Format format, std::string_view level_str,
+                       std::string_view file, int line) {
+    encoding = Encoding::MESSAGE;
+    logfmt = format == Format::LOGFMT;
+    auto& buffer = context->buffer;
+    buffer.Append(logfmt ? std::string_view("time=\"")
+                         : std::string_view("{\"time\":\""));
+    time = basic_log::detail::WallClock::Now();
+    char* out = buffer.Reserve(basic_log::detail::TimestampCache::kMaxLength);
+    buffer.Commit(basic_log::detail::TimestampCache::Format(
+        time, fraction_digits.load(std::memory_order_relaxed), out));
+    if (logfmt) {
+      buffer.Append("\" level=");
+      basic_log::detail::AppendLogfmtValue(buffer, level_str);
+      buffer.Append(" file=");
+      basic_log::detail::AppendLogfmtValue(buffer, file);
+      buffer.Append(" line=");
+    } else {
+      buffer.Append("\",\"level\":\"");
+      basic_log::detail::AppendEscaped(buffer, level_str);
+      buffer.Append("\",\"file\":\"");
+      basic_log::detail::AppendEscaped(buffer, file);
+      buffer.Append("\",\"line\":");
+    }
+    out = buffer.Reserve(basic_log::detail::kMaxNumberLength);
+    buffer.Commit(basic_log::detail::FormatInteger(out, line));
+  }
+
+  /// @brief Start the "msg" string, or separate the next value in it.
+  void OpenMessage(bool space) {
+    auto& buffer = context->buffer;
+    if (!message_open) {
+      message_open = true;
+      message_start = buffer.size();
+      buffer.Append(logfmt ? std::string_view(" msg=\"")
+                           : std::string_view(",\"msg\":\""));
+    } else if (space) {
+      buffer.Append(' ');
+    }
+  }
+
+  void AppendKey(basic_log::detail::FieldKey key) {
+    auto& buffer = context->buffer;
+    if (logfmt) {
+      buffer.Append(' ');
+      if (key.plain) {
+        buffer.Append(key.name);
+      } else {
+        basic_log::detail::AppendLogfmtKey(buffer, key.name);
+      }
+      buffer.Append('=');
+      return;
+    }
+    buffer.Append(",\"");
+    if (key.plain) {
+      buffer.Append(key.name);
+    } else {
+      basic_log::detail::AppendEscaped(buffer, key.name);
+    }
+    buffer.Append("\":");
+  }
+
+  /**
+   * * @brief Append a field value as JSON.
+   * * @details Values without a JSON type of their own, and every value once
+   * a manipulator has changed the stream, are stored as their text.
+   */
+  template <typename T>
+  void EncodeField(const T& value) {
+    auto& buffer = context->buffer;
+    if (context->StreamIsDefault()) {
+      if constexpr (std::is_same_v<T, bool>) {
+        EncodeField(value ? basic_log::detail::Literal::TRUE_VALUE
+                          : basic_log::detail::Literal::FALSE_VALUE);
+        return;
+      } else if constexpr (basic_log::detail::kIsCharacter<T> ||
+                           std::is_convertible_v<const T&, std::string_view>) {
+        buffer.Append('"');
+        size_t start = buffer.size();
+        AppendText(value);
+        basic_log::detail::EscapeFrom(buffer, start);
+        buffer.Append('"');
+        return;
+      } else if constexpr (std::is_arithmetic_v<T>) {
+        // Object keys are strings, and JSON has no infinities or NaNs.
+        bool quoted = nesting.expecting_key;
+        if constexpr (std::is_floating_point_v<T>) {
+          quoted = quoted || !std::isfinite(value);
+        }
+        if (quoted) {
+          buffer.Append('"');
+        }
+        AppendText(value);
+        if (quoted) {
+          buffer.Append('"');
+        }
+        return;
+      }
+    }
+    buffer.Append('"');
+    size_t start = buffer.size();
+    context->stream_used = true;
+    context->stream << value;
+    basic_log::detail::EscapeFrom(buffer, start);
+    buffer.Append('"');
+  }
+
+  /// @brief The JSON counterpart of the text the standard types stream.
+  void EncodeField(basic_log::detail::Literal literal) {
+    using basic_log::detail::Literal;
+    using Kind = basic_log::detail::FieldNesting::Kind;
+    auto& buffer = context->buffer;
+    switch (literal) {
+      case Literal::TRUE_VALUE:
+      case Literal::FALSE_VALUE:
+        if (nesting.expecting_key) {
+          buffer.Append('"');
+        }
+        buffer.Append(
+            basic_log::detail::kLiterals[static_cast<size_t>(literal)]);
+        if (nesting.expecting_key) {
+          buffer.Append('"');
+        }
+        return;
+      case Literal::NULLPTR:
+      case Literal::NULLOPT:
+      case Literal::OPTIONAL_EMPTY:
+        buffer.Append("null");
+        return;
+      case Literal::OPTIONAL_OPEN:
+        nesting.Open(Kind::TRANSPARENT);
+        return;
+      case Literal::PAIR_OPEN:
+      case Literal::VECTOR_OPEN:
+      case Literal::SET_OPEN:
+        buffer.Append('[');
+        nesting.Open(Kind::ARRAY);
+        return;
+      case Literal::MAP_OPEN:
+      case Literal::UNORDERED_MAP_OPEN:
+        buffer.Append('{');
+        nesting.Open(Kind::OBJECT);
+        return;
+      case Literal::CLOSE:
+        switch (nesting.Close()) {
+          case Kind::ARRAY:
+            buffer.Append(']');
+            break;
+          case Kind::OBJECT:
+            buffer.Append('}');
+            break;
+          case Kind::NONE:
+          case Kind::TRANSPARENT:
+            break;
+        }
+        return;
+      case Literal::COMMA:
+        buffer.Append(',');
+        nesting.expecting_key = nesting.Top() == Kind::OBJECT;
+        return;
+      case Literal::COLON:
+        buffer.Append(':');
+        nesting.expecting_key = false;
+        return;
+      case Literal::EQUALS:
+        buffer.Append('=');
+        return;
+    }
+  }
+
+  /**
+   * * @brief Turn the JSON a field value was encoded as into a logfmt value:
+   * strings lose their quotes where they can, arrays and objects are quoted.
+   */
+  void FinishLogfmtValue(size_t start) {
+    auto& buffer = context->buffer;
+    size_t size = buffer.size() - start;
+    if (size == 0) {
+      buffer.Append("\"\"");
+      return;
+    }
+    char* data = buffer.data();
+    if (data[start] == '"') {
+      if (basic_log::detail::IsBareValue({data + start + 1, size - 2})) {
+        std::memmove(data + start, data + start + 1, size - 2);
+        buffer.Truncate(start + size - 2);
+      }
+      return;
+    }
+    if (data[start] != '[' && data[start] != '{') {
+      return;
+    }
+    basic_log::detail::EscapeFrom(buffer, start);
+    size_t end = buffer.size();
+    data = buffer.Reserve(2) - end;
+    std::memmove(data + start + 1, data + start, end - start);
+    data[start] = '"';
+    buffer.Commit(1);
+    buffer.Append('"');
+  }
+
+  static void PutSite(basic_log::detail::LogBuffer& buffer, const Site& site) {
+    using basic_log::detail::BinaryWriter;
+    BinaryWriter::Put(buffer, static_cast<uint8_t>(site.level));
+    BinaryWriter::PutString(buffer, site.level_str);
+    BinaryWriter::PutString(buffer, site.file);
+    BinaryWriter::Put(buffer, static_cast<uint32_t>(site.line));
+  }
+
+  /// @brief The ID of site, described to the sinks if they have not seen it.
+  static uint32_t SiteId(Site& site) {
+    uint32_t generation = site_generation.load(std::memory_order_relaxed);
+    if (site.described_in.load(std::memory_order_acquire) != generation) {
+      DescribeSite(site, generation);
+    }
+    return site.id.load(std::memory_order_relaxed);
+  }
+
+  static void DescribeSite(Site& site, uint32_t generation);
+
+  /**
+   * * @brief Whether the finished record repeats the last one of its site,
+   * see Options::dedup_window; writes the repeats of the previous one
+   * first if not.
+   */
+  bool Suppressed();
+  /// @brief Write "last message repeated N times" for site.
+  static void ReportRepeats(const Site& site, uint64_t repeated);
+  /// @brief Report the repeats counted so far at every site.
+  static void ReportAllRepeats();
+
+  /// @brief operator<< for every encoding but TEXT.
+  template <typename T>
+  void Encode(bool space, const T& value) {
+    if (encoding == Encoding::BINARY) {
+      EncodeValue(space, value);
+    } else if (encoding == Encoding::FIELD) {
+      EncodeField(value);
+    } else {
+      OpenMessage(space);
+      size_t start = context->buffer.size();
+      AppendText(value);
+      if constexpr (!std::is_arithmetic_v<T>) {
+        basic_log::detail::EscapeFrom(context->buffer, start);
+      }
+    }
+  }
+
+  /// @brief Append the text of value the way the TEXT format shows it.
+  template <typename T>
+  void AppendText(const T& value) {
+    auto& buffer = context->buffer;
+    if (context->StreamIsDefault()) {
+      if constexpr (std::is_same_v<T, bool>) {
+        buffer.Append(basic_log::detail::kLiterals[static_cast<size_t>(
+            value ? basic_log::detail::Literal::TRUE_VALUE
+                  : basic_log::detail::Literal::FALSE_VALUE)]);
+        return;
+      } else if constexpr (basic_log::detail::kIsCharacter<T>) {
+        buffer.Append(static_cast<char>(value));
+        return;
+      } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        buffer.Append(basic_log::detail::StringOf(value));
+        return;
+      } else if constexpr (std::is_integral_v<T>) {
+        char* out = buffer.Reserve(basic_log::detail::kMaxNumberLength);
+        buffer.Commit(basic_log::detail::FormatInteger(out, value));
+        return;
+      } else if constexpr (std::is_floating_point_v<T>) {
+        char* out = buffer.Reserve(basic_log::detail::kMaxNumberLength);
+        buffer.Commit(basic_log::detail::FormatFloat(
+            out, value, float_precision.load(std::memory_order_relaxed)));
+        return;
+      }
+    }
+    context->stream_used = true;
+    context->stream << value;
+  }
+
+  /// @return Whether the next value is preceded by a space.
+  bool TakeSpace() {
+    bool space = !no_space;
+    no_space = false;
+    return space;
+  }
+
+  /**
+   * * @brief Append value to a binary record.
+   * * @details Numbers and strings are stored raw. Anything else is formatted
+   * by the stream and stored as a string, as is every value once a
+   * manipulator has changed how the stream formats.
+   */
+  template <typename T>
+  void EncodeValue(bool space, const T& value) {
+    using basic_log::detail::BinaryWriter;
+    using basic_log::detail::ValueTag;
+    auto& buffer = context->buffer;
+    if (context->StreamIsDefault()) {
+      if constexpr (std::is_same_v<T, bool>) {
+        BinaryWriter::PutTag(buffer, ValueTag::LITERAL, space);
+        BinaryWriter::Put(buffer,
+                          static_cast<uint8_t>(
+                              value ? basic_log::detail::Literal::TRUE_VALUE
+                                    : basic_log::detail::Literal::FALSE_VALUE));
+        return;
+      } else if constexpr (basic_log::detail::kIsCharacter<T>) {
+        BinaryWriter::PutTag(buffer, ValueTag::STRING, space);
+        BinaryWriter::PutString(buffer,
+                                std::string_view(
+                                    reinterpret_cast<const char*>(&value), 1));
+        return;
+      } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+        BinaryWriter::PutTag(buffer, ValueTag::STRING, space);
+        BinaryWriter::PutString(buffer, basic_log::detail::StringOf(value));
+        return;
+      } else if constexpr (std::is_integral_v<T> ||
+                           std::is_floating_point_v<T>) {
+        if constexpr (std::is_floating_point_v<T>) {
+          BinaryWriter::PutTag(buffer, ValueTag::DOUBLE, space);
+          BinaryWriter::Put(buffer, static_cast<double>(value));
+        } else if constexpr (std::is_signed_v<T>) {
+          BinaryWriter::PutTag(buffer, ValueTag::INT, space);
+          BinaryWriter::Put(buffer, static_cast<int64_t>(value));
+        } else {
+          BinaryWriter::PutTag(buffer, ValueTag::UINT, space);
+          BinaryWriter::Put(buffer, static_cast<uint64_t>(value));
+        }
+        return;
+      }
+    }
+    BinaryWriter::PutTag(buffer, ValueTag::STRING, space);
+    size_t start = buffer.size();
+    BinaryWriter::Put(buffer, uint32_t{0});
+    context->stream_used = true;
+    context->stream << value;
+    auto size = static_cast<uint32_t>(buffer.size() - start - sizeof(uint32_t));
+    std::memcpy(buffer.data() + start, &size, sizeof(size));
+  }
+
+  /// @brief "name{" or, in a field, the array or the object open.
+  void OpenNamed(std::string_view name, basic_log::detail::Literal field_open) {
+    if (encoding == Encoding::FIELD) {
+      *this << field_open;
+    } else {
+      *this << name << NoSpace << "{";
+    }
+  }
+
+  template <typename T, size_t... I>
+  void LogMembers(const T& value, std::index_sequence<I...>) {
+    using std::get;
+    (LogMember(I == 0, get<I>(value)), ...);
+  }
+
+  template <typename T>
+  void LogMember(bool first, const T& member) {
+    if (!first) {
+      *this << basic_log::detail::Literal::COMMA;
+    }
+    *this << member;
+  }
+
+  template <typename T>
+  Logging& LogElements(T begin, T end, size_t size) {
+    using Element = std::remove_cv_t<std::remove_pointer_t<T>>;
+    if constexpr (std::is_pointer_v<T> && std::is_arithmetic_v<Element> &&
+                  !basic_log::detail::kIsCharacter<Element>) {
+      if ((encoding == Encoding::TEXT || encoding == Encoding::FIELD) &&
+          context->StreamIsDefault()) {
+        AppendNumbers(begin, end);
+        return *this << basic_log::detail::Literal::CLOSE;
+      }
+    }
+    ContainerLimit limit(*this);
+    for (auto it = begin; it != end;) {
+      if (limit.Reached()) {
+        *this << basic_log::detail::ElidedValue{
+            Remaining(it, end, size, limit.count)};
+        break;
+      }
+      *this << *it;
+      ++limit.count;
+      if (++it != end) {
+        *this << basic_log::detail::Literal::COMMA;
+      }
+    }
+    return *this << basic_log::detail::Literal::CLOSE;
+  }
+
+  template <typename T>
+  Logging& LogPairs(T begin, T end, size_t size) {
+    ContainerLimit limit(*this);
+    for (auto it = begin; it != end;) {
+      if (limit.Reached()) {
+        *this << basic_log::detail::ElidedValue{
+            Remaining(it, end, size, limit.count)};
+        break;
+      }
+      *this << it->first << basic_log::detail::Literal::COLON << it->second;
+      ++limit.count;
+      if (++it != end) {
+        *this << basic_log::detail::Literal::COMMA;
+      }
+    }
+    return *this << basic_log::detail::Literal::CLOSE;
+  }
+
+  /// @brief How much of a container has been written, against the limits.
+  struct ContainerLimit {
+    explicit ContainerLimit(const Logging& log)
+        : buffer(log.context->buffer),
+          start(buffer.size()),
+          max_elements(max_container_elements.load(std::memory_order_relaxed)),
+          max_bytes(max_container_bytes.load(std::memory_order_relaxed)) {}
+
+    bool Reached() const {
+      return count >= max_elements || buffer.size() - start >= max_bytes;
+    }
+
+    const basic_log::detail::LogBuffer& buffer;
+    const size_t start;
+    const size_t max_elements;
+    const size_t max_bytes;
+    size_t count{0};
+  };
+
+  /// @return The number of elements in [it, end), of size in total.
+  template <typename T>
+  static size_t Remaining(T it, T end, size_t size, size_t written) {
+    if (size != kUnknownSize) {
+      return size - written;
+    }
+    return static_cast<size_t>(std::distance(it, end));
+  }
+
+  /**
+   * * @brief The elements of a contiguous range of numbers, formatted in one
+   * loop without a round through operator<< per element.
+   * * @details Writes what LogElements would, one Reserve per element.
+   */
+  template <typename T>
+  void AppendNumbers(const T* begin, const T* end) {
+    auto& buffer = context->buffer;
+    ContainerLimit limit(*this);
+    bool field = encoding == Encoding::FIELD;
+    bool space = TakeSpace() && !field;
+    int precision = float_precision.load(std::memory_order_relaxed);
+    for (const T* it = begin; it != end; ++it) {
+      if (limit.Reached()) {
+        if (it != begin) {
+          *this << basic_log::detail::Literal::COMMA;
+        }
+        *this << basic_log::detail::ElidedValue{
+            static_cast<size_t>(end - it)};
+        return;
+      }
+      char* out = buffer.Reserve(basic_log::detail::kMaxNumberLength + 4);
+      char* next = out;
+      if (it != begin) {
+        if (!field) {
+          *next++ = ' ';
+        }
+        *next++ = ',';
+        space = !field;
+      }
+      if (space) {
+        *next++ = ' ';
+      }
+      if constexpr (std::is_same_v<T, bool>) {
+        std::string_view text =
+            basic_log::detail::kLiterals[static_cast<size_t>(
+                *it ? basic_log::detail::Literal::TRUE_VALUE
+                    : basic_log::detail::Literal::FALSE_VALUE)];
+        std::memcpy(next, text.data(), text.size());
+        next += text.size();
+      } else if constexpr (std::is_integral_v<T>) {
+        next += basic_log::detail::FormatInteger(next, *it);
+      } else {
+        // JSON has no infinities or NaNs.
+        bool quoted = field && !std::isfinite(*it);
+        if (quoted) {
+          *next++ = '"';
+        }
+        next += basic_log::detail::FormatFloat(next, *it, precision);
+        if (quoted) {
+          *next++ = '"';
+        }
+      }
+      buffer.Commit(static_cast<size_t>(next - out));
+      ++limit.count;
+    }
+  }
+
+  /**
+   * * @brief Hand the finished record in buffer to the sinks or the writer
+   * thread; the writer takes over buffer's storage instead of a copy.
+   * * @param time When the record was created; orders it with strict_ordering.
+   */
+  static void Dispatch(LogLevel level, basic_log::detail::LogBuffer& buffer,
+                       std::chrono::system_clock::time_point time);
+  /**
+   * * @brief Put next in effect and retire the configuration it replaces.
+   * * @details Once no thread can use the old configuration any more, its
+   * writer thread is stopped, which writes everything still queued, and its
+   * sinks are flushed and released.
+   */
+  static void Publish(Config* next);
+  static void WriteToSinks(const Config& config, const Record* records,
+                           size_t count, SinkGroup group = SinkGroup::ALL);
+  static void FlushSinks(const Config& config);
+  /// @brief FlushSinks for the configuration in effect.
+  static void FlushSinks();
+  static void Shutdown();
+  /// @brief Periodic flushing in the synchronous mode; guarded by
+  /// Engine::config_mutex.
+  static std::unique_ptr<FlushTimer>& PeriodicFlush();
+  static basic_log::detail::VModule& VModuleRules();
+  /// @brief The level caches resolved so far.
+  static std::vector<std::atomic<int>*>& LevelCaches();
+  static int ResolveLevel(std::atomic<int>& cache, const char* file);
+  /// @brief Make every statement resolve its level again.
+  static void InvalidateLevels();
+  static void OnCrashSignal(int signal);
+
+  /// @brief A registered cache whose level has to be resolved again.
+  static constexpr int kLevelStale = -2;
+
   /// @brief The current logging level.
   static inline std::atomic<LogLevel> current_level{DEBUG};
+  /// @brief Fractional digits of the prefix timestamp (0, 3 or 6).
+  static inline std::atomic<int> fraction_digits{0};
+  static inline std::atomic<Format> record_format{Format::TEXT};
+  /// @brief See Options::float_precision.
+  static inline std::atomic<int> float_precision{6};
+  /// @brief See Options::max_container_elements; SIZE_MAX for no limit.
+  static inline std::atomic<size_t> max_container_elements{1000};
+  /// @brief See Options::max_container_bytes; SIZE_MAX for no limit.
+  static inline std::atomic<size_t> max_container_bytes{64 * 1024};
+  /// @brief Bumped by BasicConfig, so that sites are described to new sinks.
+  static inline std::atomic<uint32_t> site_generation{1};
+  static inline std::atomic<uint32_t> next_site_id{1};
+  /// @brief The sinks and the writer thread; see Config.
+  static inline std::atomic<Config*> config{nullptr};
+  static inline std::atomic<uint64_t> dropped_records{0};
+  /// @brief See Options::latency_stats.
+  static inline std::atomic<bool> latency_stats{false};
+  /// @brief See Options::dedup_window, in nanoseconds.
+  static inline std::atomic<int64_t> dedup_window{0};
+  /// @brief The sites that have counted repeats, linked by next_repeating.
+  static inline std::atomic<Site*> repeating_sites{nullptr};
+
+  /// @brief How the values streamed next are encoded.
+  enum class Encoding : uint8_t {
+    TEXT,
+    BINARY,
+    /// @brief Into the "msg" string of a JSON or LOGFMT record.
+    MESSAGE,
+    /// @brief As the value of a field, see With.
+    FIELD,
+  };
+
+  LogLevel level;
   bool no_space{false};
-  std::optional<std::ostringstream> oss;
+  Encoding encoding{Encoding::TEXT};
+  /// @brief Whether a JSON or LOGFMT record is LOGFMT.
+  bool logfmt{false};
+  /// @brief Whether the "msg" string has begun.
+  bool message_open{false};
+  /// @brief Set for a field formatted for ScopedContext, not a record.
+  bool field_only{false};
+  /// @brief Where the "msg" member begins; later fields are moved before it.
+  size_t message_start{0};
+  /// @brief The statement, if the record was created by a LOG macro.
+  Site* site{nullptr};
+  /// @brief Where the part of the record that can repeat begins, after the
+  /// prefix and its timestamp.
+  size_t body_start{0};
+  basic_log::detail::FieldNesting nesting;
+  /// @brief When the record was created.
+  std::chrono::system_clock::time_point time;
+  /// @brief Where the record is built.
+  basic_log::detail::FormatContext* context{nullptr};
+};
+
+#ifndef BASIC_LOG_COMPILED_LIB
+// The compiled library leaves these to the files that use the sinks.
+#include "basic_log_sink.h"
+#include "basic_log_mmap_sink.h"
+#include "basic_log_network_sink.h"
+#endif
+
+/**
+ * * @brief Adds a field to every record the thread makes while it exists,
+ * such as a request's trace ID.
+ * * @details "Logging::ScopedContext trace{"trace", id};" makes every record
+ * the thread creates in the scope carry trace=id, as if it was attached
+ * with With, right after the prefix. The value is formatted once, for every
+ * record format, when the context is created and kept in the thread's
+ * ContextStack; a record then copies the fields of all open contexts with a
+ * single memcpy. Contexts nest, and must be destroyed in the reverse order
+ * of their creation, which scopes guarantee.
+ * * @note A field that does not fit into the room left in the stack for
+ * any one format is left out of every format, so records of all formats
+ * carry the same fields. Code that moves between threads should only
+ * destroy a context on another thread if that thread runs with the fields
+ * it had, installed through Context, as KeepContext does.
+ */
+class Logging::ScopedContext {
+ public:
+  template <typename T>
+  ScopedContext(basic_log::detail::FieldKey key, const T& value)
+      : mark(basic_log::detail::ContextStack::Local().Top()) {
+    auto& stack = basic_log::detail::ContextStack::Local();
+    for (size_t format = 0; format < stack.kFormats; ++format) {
+      Logging field(static_cast<Format>(format), ContextField());
+      field.With(key, value);
+      const auto& buffer = field.context->buffer;
+      if (!stack.Push(format, {buffer.data(), buffer.size()})) {
+        stack.Restore(mark);
+        return;
+      }
+    }
+  }
+
+  ~ScopedContext() { basic_log::detail::ContextStack::Local().Restore(mark); }
+
+  ScopedContext(const ScopedContext&) = delete;
+  ScopedContext& operator=(const ScopedContext&) = delete;
+
+ private:
+  const basic_log::detail::ContextStack::Mark mark;
+};
+
+/**
+ * * @brief A handle to the fields of the scoped contexts open on a thread at
+ * one point, to carry them over to work that continues elsewhere.
+ * * @details Thread pools and coroutines move a request's work between
+ * threads, and the thread-local ContextStack does not follow it. Capture the
+ * context where the work is handed off with Current and install it where it
+ * continues with a ContextScope, or let BindContext and KeepContext do both.
+ * The fields are copied once, by Current; copying a Context only shares
+ * them, and capturing a thread without fields allocates nothing.
+ */
+class Logging::Context {
+ public:
+  /// @brief No fields.
+  Context() = default;
+
+  /// @brief The fields of the calling thread's scoped contexts.
+  static Context Current() {
+    auto& stack = basic_log::detail::ContextStack::Local();
+    Context context;
+    if (!stack.Empty()) {
+      context.fields =
+          std::make_shared<const basic_log::detail::ContextFields>(stack);
+    }
+    return context;
+  }
+
+  bool Empty() const { return fields == nullptr; }
+
+  /**
+   * * @brief Give the calling thread these fields instead of its own, until
+   * it installs others; ContextScope does so for a scope.
+   */
+  void Install() const {
+    auto& stack = basic_log::detail::ContextStack::Local();
+    if (fields != nullptr) {
+      fields->CopyTo(stack);
+    } else {
+      stack.Restore({});
+    }
+  }
+
+ private:
+  std::shared_ptr<const basic_log::detail::ContextFields> fields;
+};
+
+/**
+ * * @brief Installs a Context on the calling thread for the scope, e.g.
+ * around a task an executor runs, and gives the thread its own fields back
+ * at the end.
+ * * @details ScopedContexts created in the scope add to the installed fields
+ * and have to be destroyed before it ends.
+ */
+class Logging::ContextScope {
+ public:
+  explicit ContextScope(const Context& context)
+      : saved(basic_log::detail::ContextStack::Local()) {
+    context.Install();
+  }
+
+  ~ContextScope() { saved.CopyTo(basic_log::detail::ContextStack::Local()); }
+
+  ContextScope(const ContextScope&) = delete;
+  ContextScope& operator=(const ContextScope&) = delete;
+
+ private:
+  const basic_log::detail::ContextFields saved;
+};
+
+template <typename F>
+auto Logging::BindContext(F function) {
+  return [context = Context::Current(), function = std::move(function)](
+             auto&&... args) mutable -> decltype(auto) {
+    ContextScope scope(context);
+    return function(std::forward<decltype(args)>(args)...);
+  };
+}
+
+#ifdef __cpp_impl_coroutine
+/**
+ * * @brief An awaitable that captures the coroutine's context when it
+ * suspends and installs it on the thread it resumes on, see KeepContext.
+ * * @details The fields stay installed on that thread until it installs
+ * others. Executors that run every resumption under a ContextScope, e.g.
+ * by posting it through BindContext, give the thread its own fields back
+ * afterwards.
+ */
+template <typename Awaitable>
+class Logging::ContextAwaiter {
+ public:
+  explicit ContextAwaiter(Awaitable&& awaitable)
+      : awaiter(basic_log::detail::GetAwaiter(
+            std::forward<Awaitable>(awaitable))) {}
+
+  bool await_ready() { return awaiter.await_ready(); }
+
+  template <typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+    context = Context::Current();
+    suspended = true;
+    return awaiter.await_suspend(handle);
+  }
+
+  decltype(auto) await_resume() {
+    if (suspended) {
+      context.Install();
+    }
+    return awaiter.await_resume();
+  }
+
+ private:
+  basic_log::detail::StoredAwaiter<Awaitable> awaiter;
+  Context context;
+  bool suspended{false};
 };
 
-Logging& operator<<(Logging& log, bool value) {
-  return log << (value ? "true" : "false");
+template <typename Awaitable>
+Logging::ContextAwaiter<Awaitable> Logging::KeepContext(
+    Awaitable&& awaitable) {
+  return ContextAwaiter<Awaitable>(std::forward<Awaitable>(awaitable));
+}
+#endif
+
+inline Logging& operator<<(Logging& log, bool value) {
+  return log << (value ? basic_log::detail::Literal::TRUE_VALUE
+                       : basic_log::detail::Literal::FALSE_VALUE);
 }
 
 template <typename K, typename V>
 Logging& operator<<(Logging& log, const std::pair<K, V>& value) {
-  log << "std::pair{" << value.first << "," << value.second << "}";
+  log << basic_log::detail::Literal::PAIR_OPEN << value.first
+      << basic_log::detail::Literal::COMMA << value.second
+      << basic_log::detail::Literal::CLOSE;
   return log;
 }
 
 template <typename T>
 Logging& operator<<(Logging& log, const std::vector<T>& value) {
-  return log.LogSequence("std::vector", value.begin(), value.end());
+  if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool>) {
+    // Pointers select the bulk path for numbers.
+    return log.LogSequence(basic_log::detail::Literal::VECTOR_OPEN,
+                           value.data(), value.data() + value.size());
+  } else {
+    return log.LogSequence(basic_log::detail::Literal::VECTOR_OPEN,
+                           value.begin(), value.end(), value.size());
+  }
 }
 
 template <typename T>
 Logging& operator<<(Logging& log, const std::set<T>& value) {
-  return log.LogSequence("std::set", value.begin(), value.end());
+  return log.LogSequence(basic_log::detail::Literal::SET_OPEN, value.begin(),
+                         value.end(), value.size());
 }
 
 template <typename K, typename V>
 Logging& operator<<(Logging& log, const std::map<K, V>& value) {
-  return log.LogMapping("std::map", value.begin(), value.end());
+  return log.LogMapping(basic_log::detail::Literal::MAP_OPEN, value.begin(),
+                        value.end(), value.size());
 }
 
 template <typename K, typename V>
 Logging& operator<<(Logging& log, const std::unordered_map<K, V>& value) {
-  return log.LogMapping("std::unordered_map", value.begin(), value.end());
+  return log.LogMapping(basic_log::detail::Literal::UNORDERED_MAP_OPEN,
+                        value.begin(), value.end(), value.size());
+}
+/**
+ * * @brief Any other range: std::deque, std::array, std::list, hash maps and
+ * the like, named after their template at compile time.
+ */
+template <typename T,
+          std::enable_if_t<basic_log::detail::kFormatsAsRange<T>, int> = 0>
+Logging& operator<<(Logging& log, const T& value) {
+  using std::begin;
+  using std::end;
+  constexpr std::string_view name = basic_log::detail::kContainerName<T>;
+  size_t size = Logging::kUnknownSize;
+  if constexpr (basic_log::detail::HasSize<T>::value) {
+    size = static_cast<size_t>(std::size(value));
+  }
+  if constexpr (basic_log::detail::IsMapLike<T>::value) {
+    return log.LogMapping(name, begin(value), end(value), size);
+  } else if constexpr (basic_log::detail::IsContiguous<T>::value) {
+    // Pointers select the bulk path for numbers.
+    return log.LogSequence(name, std::data(value), std::data(value) + size,
+                           size);
+  } else {
+    return log.LogSequence(name, begin(value), end(value), size);
+  }
 }
+
+/// @brief std::tuple and any other tuple-like type but std::pair.
+template <typename T,
+          std::enable_if_t<basic_log::detail::kFormatsAsTuple<T>, int> = 0>
+Logging& operator<<(Logging& log, const T& value) {
+  return log.LogTuple(basic_log::detail::kContainerName<T>, value);
+}
+
 template <typename T>
 Logging& operator<<(Logging& log, const std::optional<T>& value) {
   if (value.has_value()) {
-    return log << "std::optional{" << value.value() << "}";
+    return log << basic_log::detail::Literal::OPTIONAL_OPEN << value.value()
+               << basic_log::detail::Literal::CLOSE;
   } else {
-    return log << "std::optional{ nullopt }";
+    return log << basic_log::detail::Literal::OPTIONAL_EMPTY;
   }
 }
 
-Logging& operator<<(Logging& log, std::nullptr_t) { return log << "nullptr"; }
+inline Logging& operator<<(Logging& log, std::nullptr_t) {
+  return log << basic_log::detail::Literal::NULLPTR;
+}
 
-Logging& operator<<(Logging& log, std::nullopt_t) {
-  return log << "std::nullopt";
+inline Logging& operator<<(Logging& log, std::nullopt_t) {
+  return log << basic_log::detail::Literal::NULLOPT;
 }
 
-Logging& operator<<(Logging& log, std::chrono::seconds value) {
-  return log << value.count() << "seconds";
+inline Logging& operator<<(Logging& log, std::chrono::seconds value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::SECONDS};
 }
 
-Logging& operator<<(Logging& log, std::chrono::milliseconds value) {
-  return log << value.count() << "milliseconds";
+inline Logging& operator<<(Logging& log, std::chrono::milliseconds value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::MILLISECONDS};
 }
 
-Logging& operator<<(Logging& log, std::chrono::microseconds value) {
-  return log << value.count() << "microseconds";
+inline Logging& operator<<(Logging& log, std::chrono::microseconds value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::MICROSECONDS};
 }
 
-Logging& operator<<(Logging& log, std::chrono::nanoseconds value) {
-  return log << value.count() << "nanoseconds";
+inline Logging& operator<<(Logging& log, std::chrono::nanoseconds value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::NANOSECONDS};
 }
 
-Logging& operator<<(Logging& log, std::chrono::hours value) {
-  return log << value.count() << "hours";
+inline Logging& operator<<(Logging& log, std::chrono::hours value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::HOURS};
 }
 
-Logging& operator<<(Logging& log, std::chrono::minutes value) {
-  return log << value.count() << "minutes";
+inline Logging& operator<<(Logging& log, std::chrono::minutes value) {
+  return log << basic_log::detail::DurationValue{
+             value.count(), basic_log::detail::DurationUnit::MINUTES};
 }
 
 inline Logging& operator<<(Logging& log,
                            std::chrono::system_clock::time_point value) {
-  auto time = std::chrono::system_clock::to_time_t(value);
-  return log << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+  return log << basic_log::detail::TimePointValue{
+             std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 value.time_since_epoch())
+                 .count()};
 }
 
 
@@ -240,10 +1695,87 @@ inline Logging& operator<<(Logging& log,
  * name and line number each time. The macro also allows for chaining of
  * logging messages, making it easy to log multiple messages in a single
  * statement.
+ * * @note Statements below BASIC_LOG_MIN_LEVEL are discarded at compile time.
+ * For the others the level, including the SetVModule override of the file,
+ * is checked before the Logging object is created;
+ * when it filters the record out, the streamed arguments are not evaluated.
+ * The macro is a single expression, so it is safe in unbraced if/else bodies.
+ */
+#define LOG(level) LOG_IF(level, true)
+
+/**
+ * * @brief Like LOG, but only logs when condition holds.
+ * * @note condition is evaluated only if the level is enabled.
+ */
+#define LOG_IF(level, condition)                                          \
+  !(Logging::kCompiledIn<Logging::level> &&                               \
+    Logging::IsEnabled(Logging::level,                                    \
+                       BASIC_LOG_SITE_STATE(std::atomic<int>,             \
+                                            Logging::kLevelUnresolved),   \
+                       __FILE__) &&                                       \
+    (condition))                                                          \
+      ? (void)0                                                           \
+      : Logging::Voidify() & Logging(BASIC_LOG_SITE(level)).Self()
+
+/**
+ * * @brief Like LOG, but only logs the 1st, (n+1)th, (2n+1)th... time.
+ * * @note Like condition in LOG_IF, the counters of these macros only advance
+ * while the level is enabled, and they are checked before anything is
+ * formatted. Each statement keeps its own counter or time.
+ */
+#define LOG_EVERY_N(level, n)                                               \
+  LOG_IF(level, basic_log::detail::EveryN(                                  \
+                    BASIC_LOG_SITE_STATE(std::atomic<uint64_t>, 0), (n)))
+
+/// @brief Like LOG, but only logs the first n times.
+#define LOG_FIRST_N(level, n)                                               \
+  LOG_IF(level, basic_log::detail::FirstN(                                  \
+                    BASIC_LOG_SITE_STATE(std::atomic<uint64_t>, 0), (n)))
+
+/**
+ * * @brief Like LOG, but logs at most once per period, a std::chrono
+ * duration, starting with the first time.
  */
-#define LOG(level)                             \
-  (Logging::level < Logging::GetCurrentLevel() \
-       ? Logging()                             \
-       : Logging(#level, __FILE__, __LINE__))
+#define LOG_EVERY_T(level, period)                                          \
+  LOG_IF(level,                                                             \
+         basic_log::detail::EveryT(                                         \
+             BASIC_LOG_SITE_STATE(std::atomic<int64_t>, INT64_MIN), (period)))
+
+/// @brief Like LOG, but only logs with probability p, from 0 to 1.
+#define LOG_SAMPLED(level, p) LOG_IF(level, basic_log::detail::Sampled(p))
+
+/**
+ * * @brief The Logging::Site of the statement the macro is expanded in.
+ * * @details A function-local static of a lambda, so every expansion gets its
+ * own. Its prefix is rendered at compile time and it is constant-initialized,
+ * so it needs no guard either.
+ */
+#define BASIC_LOG_SITE(level)                                               \
+  ([]() -> Logging::Site& {                                                 \
+    static constexpr basic_log::detail::SitePrefix<sizeof(#level) +         \
+                                                   sizeof(__FILE__) + 24>   \
+        basic_log_prefix{#level, __FILE__, __LINE__};                       \
+    static Logging::Site basic_log_site{                                    \
+        Logging::level,          #level,                                    \
+        basic_log_prefix.file,   __LINE__,                                  \
+        basic_log_prefix.Head(), basic_log_prefix.Tail(),                   \
+        {},                      {},                                        \
+        {},                      nullptr};                                  \
+    return basic_log_site;                                                  \
+  }())
+
+/**
+ * * @brief A static of the given type, owned by the statement the macro is
+ * expanded in; constant-initialized like BASIC_LOG_SITE.
+ */
+#define BASIC_LOG_SITE_STATE(type, initial)         \
+  ([]() -> type& {                                  \
+    static type basic_log_state{initial};           \
+    return basic_log_state;                         \
+  }())
+
+#ifndef BASIC_LOG_COMPILED_LIB
+#include "basic_log_inl.h"
+#endif
 
 #endif  // BASIC_LOG_H
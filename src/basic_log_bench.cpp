@@ -0,0 +1,340 @@
+// Benchmarks of the logging hot paths.
+//
+// Usage: BasicLogBench [--benchmark_filter=...] [other benchmark flags]
+//
+// Besides the console report, the results are written as JSON to
+// BasicLogBench.json unless --benchmark_out is given. Build with
+// CMAKE_BUILD_TYPE=Release for meaningful numbers.
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "basic_log.h"
+#include "basic_log_sink.h"
+
+namespace {
+
+/// @brief Discards every record; written on the logging thread.
+class NullSink : public Logging::Sink {
+ public:
+  void Write(const Logging::Record*, size_t) override {}
+  void Flush() override {}
+  bool ThreadSafe() const override { return true; }
+};
+
+/// @brief Discards every record; written by the writer thread in the
+/// asynchronous mode, so that records are actually queued.
+class SerializedNullSink : public NullSink {
+ public:
+  bool ThreadSafe() const override { return false; }
+};
+
+void ConfigureNull(Logging::Format format) {
+  Logging::Options options;
+  options.level = Logging::INFO;
+  options.format = format;
+  options.sinks.push_back(std::make_shared<NullSink>());
+  Logging::BasicConfig(options);
+}
+
+void SetupText(const benchmark::State&) {
+  ConfigureNull(Logging::Format::TEXT);
+}
+
+void SetupBinary(const benchmark::State&) {
+  ConfigureNull(Logging::Format::BINARY);
+}
+
+void SetupJson(const benchmark::State&) {
+  ConfigureNull(Logging::Format::JSON);
+}
+
+void SetupDedup(const benchmark::State&) {
+  Logging::Options options;
+  options.level = Logging::INFO;
+  options.dedup_window = std::chrono::seconds(10);
+  options.sinks.push_back(std::make_shared<NullSink>());
+  Logging::BasicConfig(options);
+}
+
+void SetupClock(const benchmark::State& state) {
+  Logging::Options options;
+  options.level = Logging::INFO;
+  options.timestamp_precision = Logging::TimestampPrecision::MILLISECONDS;
+  options.clock_source = static_cast<Logging::ClockSource>(state.range(0));
+  options.sinks.push_back(std::make_shared<NullSink>());
+  Logging::BasicConfig(options);
+}
+
+/// @brief range(0) selects per-thread queues.
+void SetupAsync(const benchmark::State& state) {
+  Logging::Options options;
+  options.level = Logging::INFO;
+  options.async.enabled = true;
+  options.async.capacity = 1 << 16;
+  options.async.per_thread_queues = state.range(0) != 0;
+  options.sinks.push_back(std::make_shared<SerializedNullSink>());
+  Logging::BasicConfig(options);
+}
+
+void Teardown(const benchmark::State&) {
+  Logging::Flush();
+  ConfigureNull(Logging::Format::TEXT);
+}
+
+void BM_DisabledLevel(benchmark::State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    LOG(DEBUG) << "This debug message will not be shown" << ++i;
+  }
+  benchmark::DoNotOptimize(i);
+}
+BENCHMARK(BM_DisabledLevel)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_EmptyRecord(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO);
+  }
+}
+BENCHMARK(BM_EmptyRecord)->Setup(SetupText)->Teardown(Teardown);
+
+/// @brief BM_EmptyRecord with millisecond timestamps from the clock source
+/// range(0).
+void BM_ClockSource(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO);
+  }
+}
+BENCHMARK(BM_ClockSource)
+    ->ArgName("clock_source")
+    ->DenseRange(0, 3)
+    ->Setup(SetupClock)
+    ->Teardown(Teardown);
+
+void BM_Integers(benchmark::State& state) {
+  int i = 0;
+  for (auto _ : state) {
+    ++i;
+    LOG(INFO) << i << -i << 1234567890123LL << 42u;
+  }
+}
+BENCHMARK(BM_Integers)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_Doubles(benchmark::State& state) {
+  double d = 3.14555;
+  for (auto _ : state) {
+    d += 0.001;
+    LOG(INFO) << d << -d << 1e-7 << 2.5f;
+  }
+}
+BENCHMARK(BM_Doubles)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_Strings(benchmark::State& state) {
+  std::string text = "a std::string argument";
+  std::string_view view = "a string_view argument";
+  for (auto _ : state) {
+    LOG(INFO) << "a literal" << text << view << true;
+  }
+}
+BENCHMARK(BM_Strings)->Setup(SetupText)->Teardown(Teardown);
+
+/// @brief The first line of src/main.cpp.
+void BM_MixedText(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+}
+BENCHMARK(BM_MixedText)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_MixedBinary(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+}
+BENCHMARK(BM_MixedBinary)->Setup(SetupBinary)->Teardown(Teardown);
+
+void BM_MixedJson(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+}
+BENCHMARK(BM_MixedJson)->Setup(SetupJson)->Teardown(Teardown);
+
+void BM_Fields(benchmark::State& state) {
+  std::string user = "alice";
+  std::vector<int> shards{1, 4, 9};
+  int i = 0;
+  for (auto _ : state) {
+    LOG(INFO).With("req_id", ++i).With("user", user).With("shards", shards)
+        << "handled";
+  }
+}
+BENCHMARK(BM_Fields)->Setup(SetupJson)->Teardown(Teardown);
+
+/// @brief BM_MixedText with three fields of scoped contexts.
+void BM_ScopedContext(benchmark::State& state) {
+  Logging::ScopedContext trace{"trace", "4bf92f3577b34da6a3ce929d0e0e4736"};
+  Logging::ScopedContext tenant{"tenant", "acme"};
+  Logging::ScopedContext request{"req_id", 12345};
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+}
+BENCHMARK(BM_ScopedContext)->Setup(SetupText)->Teardown(Teardown);
+
+/// @brief BM_MixedText where every record repeats the last one and is only
+/// counted.
+void BM_Repeated(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+}
+BENCHMARK(BM_Repeated)->Setup(SetupDedup)->Teardown(Teardown);
+
+void BM_Vector(benchmark::State& state) {
+  std::vector<int> values(static_cast<size_t>(state.range(0)));
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i * 7);
+  }
+  for (auto _ : state) {
+    LOG(INFO) << "Vector:" << values;
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Vector)->Arg(4)->Arg(64)->Setup(SetupText)->Teardown(Teardown);
+
+// Bounded by Options::max_container_elements rather than the size.
+void BM_LargeVector(benchmark::State& state) {
+  std::vector<int> values(1 << 20, 12345);
+  for (auto _ : state) {
+    LOG(INFO) << "Vector:" << values;
+  }
+}
+BENCHMARK(BM_LargeVector)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_Map(benchmark::State& state) {
+  std::map<std::string, int> values{
+      {"key1", 1}, {"key2", 2}, {"key3", 3}, {"key4", 4}};
+  for (auto _ : state) {
+    LOG(INFO) << "Map:" << values;
+  }
+}
+BENCHMARK(BM_Map)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_Optional(benchmark::State& state) {
+  std::optional<int> some{42};
+  std::optional<int> none;
+  for (auto _ : state) {
+    LOG(INFO) << some << none;
+  }
+}
+BENCHMARK(BM_Optional)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_Durations(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << std::chrono::seconds(1) << std::chrono::milliseconds(1000)
+              << std::chrono::microseconds(1000)
+              << std::chrono::nanoseconds(1000);
+  }
+}
+BENCHMARK(BM_Durations)->Setup(SetupText)->Teardown(Teardown);
+
+void BM_TimePoint(benchmark::State& state) {
+  auto now = std::chrono::system_clock::now();
+  for (auto _ : state) {
+    LOG(INFO) << now;
+  }
+}
+BENCHMARK(BM_TimePoint)->Setup(SetupText)->Teardown(Teardown);
+
+/// @brief Cost on the producer of handing a record to the writer thread.
+void BM_AsyncEnqueue(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+  state.counters["dropped"] =
+      static_cast<double>(Logging::GetDroppedCount());
+}
+BENCHMARK(BM_AsyncEnqueue)
+    ->ArgName("per_thread_queues")
+    ->Arg(0)
+    ->Arg(1)
+    ->Setup(SetupAsync)
+    ->Teardown(Teardown);
+
+/// @brief Like BM_AsyncEnqueue, for a record of a few kilobytes.
+void BM_AsyncLongRecord(benchmark::State& state) {
+  std::vector<int> values(512);
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i] = static_cast<int>(i * 7919);
+  }
+  for (auto _ : state) {
+    LOG(INFO) << "Values:" << values;
+  }
+}
+BENCHMARK(BM_AsyncLongRecord)
+    ->ArgName("per_thread_queues")
+    ->Arg(0)
+    ->Arg(1)
+    ->Setup(SetupAsync)
+    ->Teardown(Teardown);
+
+void BM_Throughput(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_Throughput)
+    ->ThreadRange(1, 64)
+    ->UseRealTime()
+    ->Setup(SetupText)
+    ->Teardown(Teardown);
+
+/// @brief Producer throughput; a full queue makes producers wait for the
+/// writer.
+void BM_AsyncThroughput(benchmark::State& state) {
+  for (auto _ : state) {
+    LOG(INFO) << "This is an info" << 11 << "message" << 3.14555;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AsyncThroughput)
+    ->ArgName("per_thread_queues")
+    ->Arg(0)
+    ->Arg(1)
+    ->ThreadRange(1, 64)
+    ->UseRealTime()
+    ->Setup(SetupAsync)
+    ->Teardown(Teardown);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<char*> args(argv, argv + argc);
+  bool has_out = false;
+  for (char* arg : args) {
+    has_out = has_out || std::strncmp(arg, "--benchmark_out=", 16) == 0;
+  }
+  char out[] = "--benchmark_out=BasicLogBench.json";
+  char out_format[] = "--benchmark_out_format=json";
+  if (!has_out) {
+    args.push_back(out);
+    args.push_back(out_format);
+  }
+  int count = static_cast<int>(args.size());
+  benchmark::Initialize(&count, args.data());
+  if (benchmark::ReportUnrecognizedArguments(count, args.data())) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
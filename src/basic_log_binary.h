@@ -0,0 +1,209 @@
+#ifndef BASIC_LOG_BINARY_H
+#define BASIC_LOG_BINARY_H
+
+// The binary record format, shared by the logger and BasicLogDecode.
+//
+// The output is a sequence of frames: a FrameKind byte, the payload size as
+// a uint32_t and the payload. Numbers are stored in host byte order, so a
+// log is decoded on a machine of the same endianness.
+//
+//   SITE  payload: uint32_t id, uint8_t level, string level name,
+//                  string file, uint32_t line
+//   EVENT payload: uint32_t site id, int64_t nanoseconds since the epoch,
+//                  uint8_t fraction digits, int8_t float precision,
+//                  [inline site], values...
+//
+// A string is a uint32_t length followed by the bytes. An event of site id 0
+// carries its site inline (uint8_t level, string level name, string file,
+// uint32_t line). Each value starts with a ValueTag byte; kNoSpace is set in
+// it when the text form has no space in front of the value.
+
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "basic_log_buffer.h"
+
+namespace basic_log {
+namespace detail {
+
+enum class FrameKind : uint8_t { SITE = 1, EVENT = 2 };
+
+/// @brief Size of the kind byte and the payload size of a frame.
+inline constexpr size_t kFrameHeaderSize = 1 + sizeof(uint32_t);
+
+enum class ValueTag : uint8_t {
+  /// @brief int64_t.
+  INT = 1,
+  /// @brief uint64_t.
+  UINT,
+  /// @brief double, rendered with the float precision of the event.
+  DOUBLE,
+  /// @brief A string, including the text of values without an encoder.
+  STRING,
+  /// @brief uint8_t index into kLiterals.
+  LITERAL,
+  /// @brief int64_t count and uint8_t DurationUnit.
+  DURATION,
+  /// @brief int64_t nanoseconds since the epoch, rendered in local time.
+  TIME_POINT,
+};
+
+inline constexpr uint8_t kNoSpace = 0x80;
+
+/**
+ * * @brief Fixed pieces of text the standard type overloads produce.
+ * * @details Streaming one of these costs a single byte in a binary record
+ * and a plain copy in a text record.
+ */
+enum class Literal : uint8_t {
+  TRUE_VALUE,
+  FALSE_VALUE,
+  NULLPTR,
+  NULLOPT,
+  OPTIONAL_EMPTY,
+  OPTIONAL_OPEN,
+  PAIR_OPEN,
+  VECTOR_OPEN,
+  SET_OPEN,
+  MAP_OPEN,
+  UNORDERED_MAP_OPEN,
+  CLOSE,
+  COMMA,
+  COLON,
+  EQUALS,
+};
+
+inline constexpr std::string_view kLiterals[] = {
+    "true",
+    "false",
+    "nullptr",
+    "std::nullopt",
+    "std::optional{ nullopt }",
+    "std::optional{",
+    "std::pair{",
+    "std::vector{",
+    "std::set{",
+    "std::map{",
+    "std::unordered_map{",
+    "}",
+    ",",
+    ":",
+    "=",
+};
+
+enum class DurationUnit : uint8_t {
+  HOURS,
+  MINUTES,
+  SECONDS,
+  MILLISECONDS,
+  MICROSECONDS,
+  NANOSECONDS,
+};
+
+inline constexpr std::string_view kDurationUnits[] = {
+    "hours",        "minutes",      "seconds",
+    "milliseconds", "microseconds", "nanoseconds",
+};
+
+/// @brief A duration as streamed into a record.
+struct DurationValue {
+  int64_t count;
+  DurationUnit unit;
+};
+
+/// @brief The elements of a container left out of a record.
+struct ElidedValue {
+  size_t count;
+};
+
+/// @brief A system_clock time point as streamed into a record.
+struct TimePointValue {
+  int64_t nanoseconds;
+};
+
+/**
+ * * @brief Appends binary fields to a LogBuffer.
+ */
+struct BinaryWriter {
+  template <typename T>
+  static void Put(LogBuffer& buffer, T value) {
+    std::memcpy(buffer.Reserve(sizeof(T)), &value, sizeof(T));
+    buffer.Commit(sizeof(T));
+  }
+
+  static void PutString(LogBuffer& buffer, std::string_view text) {
+    Put(buffer, static_cast<uint32_t>(text.size()));
+    buffer.Append(text);
+  }
+
+  static void PutTag(LogBuffer& buffer, ValueTag tag, bool space) {
+    Put(buffer, static_cast<uint8_t>(static_cast<uint8_t>(tag) |
+                                     (space ? 0 : kNoSpace)));
+  }
+
+  /// @brief Start a frame; its size is filled in by EndFrame.
+  static void BeginFrame(LogBuffer& buffer, FrameKind kind) {
+    Put(buffer, kind);
+    Put(buffer, uint32_t{0});
+  }
+
+  /// @param start Where the frame begins in buffer.
+  static void EndFrame(LogBuffer& buffer, size_t start) {
+    auto size = static_cast<uint32_t>(buffer.size() - start - kFrameHeaderSize);
+    std::memcpy(buffer.data() + start + 1, &size, sizeof(size));
+  }
+};
+
+/**
+ * * @brief Reads binary fields from a byte range.
+ * * @details Every getter returns false, and leaves the reader alone, if the
+ * range is too short.
+ */
+class BinaryReader {
+ public:
+  explicit BinaryReader(std::string_view bytes)
+      : next(bytes.data()), end(bytes.data() + bytes.size()) {}
+
+  template <typename T>
+  bool Get(T& value) {
+    if (static_cast<size_t>(end - next) < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, next, sizeof(T));
+    next += sizeof(T);
+    return true;
+  }
+
+  bool GetString(std::string_view& text) {
+    uint32_t size = 0;
+    const char* start = next;
+    if (!Get(size) || static_cast<size_t>(end - next) < size) {
+      next = start;
+      return false;
+    }
+    text = std::string_view(next, size);
+    next += size;
+    return true;
+  }
+
+  bool GetBytes(size_t size, std::string_view& bytes) {
+    if (static_cast<size_t>(end - next) < size) {
+      return false;
+    }
+    bytes = std::string_view(next, size);
+    next += size;
+    return true;
+  }
+
+  bool Empty() const { return next == end; }
+
+ private:
+  const char* next;
+  const char* end;
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_BINARY_H
@@ -0,0 +1,135 @@
+#ifndef BASIC_LOG_BLOCK_POOL_H
+#define BASIC_LOG_BLOCK_POOL_H
+
+// The pooled memory finished records are handed to the writer thread in.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string_view>
+#include <utility>
+
+#include "basic_log_buffer.h"
+#include "basic_log_ring.h"
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief Free list of the heap blocks finished records are handed off in.
+ * * @details Shared by all threads: logging threads take blocks to format
+ * into, the writer thread gives them back once the records are written.
+ * Blocks that grew beyond kMaxPooledCapacity, and blocks given back while the
+ * list is full, are freed instead.
+ */
+class BlockPool {
+ public:
+  static constexpr size_t kCapacity = 1024;
+  /// @brief The least a block holds; small, since every record in flight
+  /// keeps its block.
+  static constexpr size_t kBlockCapacity = 128;
+  static constexpr size_t kMaxPooledCapacity = 16 * 1024;
+
+  struct Block {
+    char* data{nullptr};
+    size_t capacity{0};
+  };
+
+  /// @return A block of at least min_capacity bytes.
+  static Block Take(size_t min_capacity) {
+    Block block;
+    if (!Free().TryPop(block) || block.capacity < min_capacity) {
+      std::free(block.data);
+      block.capacity = std::max(min_capacity, kBlockCapacity);
+      block.data = static_cast<char*>(std::malloc(block.capacity));
+      if (block.data == nullptr) {
+        throw std::bad_alloc();
+      }
+    }
+    return block;
+  }
+
+  static void Give(Block block) {
+    if (block.capacity > kMaxPooledCapacity || !Free().TryPush(block)) {
+      std::free(block.data);
+    }
+  }
+
+ private:
+  static MpscRing<Block>& Free() {
+    // Never destroyed, so that records written during exit can still give
+    // their blocks back.
+    static auto* free = new MpscRing<Block>(kCapacity);
+    return *free;
+  }
+};
+
+/**
+ * * @brief The text of a finished record, owning the pooled block it was
+ * formatted in.
+ */
+class RecordBlock {
+ public:
+  RecordBlock() = default;
+
+  /**
+   * * @brief Move the contents of buffer out without copying them, and let
+   * it continue in a fresh pooled block.
+   * * @details Used to hand a finished record to the writer thread. Only
+   * contents still in the inline arena are copied, so a buffer that is
+   * reused for every record of a thread formats straight into pooled memory
+   * from its first handoff on.
+   */
+  static RecordBlock Detach(LogBuffer& buffer) {
+    RecordBlock record;
+    if (buffer.ptr == buffer.inline_data) {
+      record.block = BlockPool::Take(buffer.length);
+      std::memcpy(record.block.data, buffer.inline_data, buffer.length);
+    } else {
+      record.block = {buffer.ptr, buffer.capacity};
+    }
+    record.length = buffer.length;
+    // The thread's next record likely needs about as much room.
+    BlockPool::Block next = BlockPool::Take(buffer.length);
+    buffer.ptr = next.data;
+    buffer.capacity = next.capacity;
+    buffer.length = 0;
+    return record;
+  }
+
+  ~RecordBlock() { Reset(); }
+
+  RecordBlock(RecordBlock&& other) noexcept
+      : block(std::exchange(other.block, {})),
+        length(std::exchange(other.length, 0)) {}
+  RecordBlock& operator=(RecordBlock&& other) noexcept {
+    if (this != &other) {
+      Reset();
+      block = std::exchange(other.block, {});
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  /// @brief Give the block back to the pool.
+  void Reset() {
+    if (block.data != nullptr) {
+      BlockPool::Give(block);
+      block = {};
+      length = 0;
+    }
+  }
+
+  std::string_view view() const { return {block.data, length}; }
+
+ private:
+  BlockPool::Block block;
+  size_t length{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_BLOCK_POOL_H
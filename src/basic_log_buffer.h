@@ -0,0 +1,268 @@
+#ifndef BASIC_LOG_BUFFER_H
+#define BASIC_LOG_BUFFER_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <ostream>
+#include <streambuf>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief A growable byte buffer that starts in a fixed inline arena.
+ * * @details Records shorter than kInlineCapacity never touch the heap. Longer
+ * ones grow the buffer once; Clear keeps the grown capacity, so a buffer that
+ * is reused for every record of a thread stops allocating after warm-up.
+ */
+class LogBuffer {
+ public:
+  static constexpr size_t kInlineCapacity = 512;
+
+  LogBuffer() = default;
+  ~LogBuffer() {
+    if (ptr != inline_data) {
+      std::free(ptr);
+    }
+  }
+
+  LogBuffer(const LogBuffer&) = delete;
+  LogBuffer& operator=(const LogBuffer&) = delete;
+
+  void Append(const char* data, size_t len) {
+    std::memcpy(Reserve(len), data, len);
+    length += len;
+  }
+  void Append(std::string_view data) { Append(data.data(), data.size()); }
+  void Append(char c) {
+    *Reserve(1) = c;
+    ++length;
+  }
+
+  /**
+   * * @brief Make room for len more bytes.
+   * * @return Where to write them; call Commit with the count written.
+   */
+  char* Reserve(size_t len) {
+    if (length + len > capacity) {
+      Grow(length + len);
+    }
+    return ptr + length;
+  }
+  void Commit(size_t len) { length += len; }
+
+  void Clear() { length = 0; }
+  /// @brief Drop everything after the first len bytes.
+  void Truncate(size_t len) {
+    if (len < length) {
+      length = len;
+    }
+  }
+  char* data() { return ptr; }
+  const char* data() const { return ptr; }
+  size_t size() const { return length; }
+  std::string_view view() const { return {ptr, length}; }
+
+ private:
+  friend class RecordBlock;
+
+  void Grow(size_t min_capacity) {
+    size_t new_capacity = capacity * 2;
+    while (new_capacity < min_capacity) {
+      new_capacity *= 2;
+    }
+    char* grown = static_cast<char*>(
+        ptr == inline_data ? std::malloc(new_capacity)
+                           : std::realloc(ptr, new_capacity));
+    if (grown == nullptr) {
+      throw std::bad_alloc();
+    }
+    if (ptr == inline_data) {
+      std::memcpy(grown, inline_data, length);
+    }
+    ptr = grown;
+    capacity = new_capacity;
+  }
+
+  char* ptr{inline_data};
+  size_t length{0};
+  size_t capacity{kInlineCapacity};
+  char inline_data[kInlineCapacity];
+};
+
+/// @brief Room FormatInteger and FormatFloat need at most.
+inline constexpr size_t kMaxNumberLength = 64;
+
+/// @brief Highest float precision FormatFloat accepts.
+inline constexpr int kMaxFloatPrecision = 30;
+
+template <typename T>
+inline size_t FormatInteger(char* out, T value) {
+  return static_cast<size_t>(std::to_chars(out, out + kMaxNumberLength, value)
+                                 .ptr -
+                             out);
+}
+
+/**
+ * * @brief Format value like std::ostream with default flags, i.e. like
+ * printf's %g, with the given precision.
+ * * @param precision Significant digits, or -1 for the shortest text that
+ * reads back as the same value.
+ */
+template <typename T>
+inline size_t FormatFloat(char* out, T value, int precision) {
+  std::to_chars_result result =
+      precision < 0
+          ? std::to_chars(out, out + kMaxNumberLength, value)
+          : std::to_chars(out, out + kMaxNumberLength, value,
+                          std::chars_format::general, precision);
+  return result.ec == std::errc() ? static_cast<size_t>(result.ptr - out) : 0;
+}
+
+template <typename T>
+inline constexpr bool kIsCharacter = std::is_same_v<T, char> ||
+                                     std::is_same_v<T, signed char> ||
+                                     std::is_same_v<T, unsigned char>;
+
+/**
+ * * @brief The text of a value that converts to std::string_view; a null
+ * character pointer is empty.
+ */
+template <typename T>
+inline std::string_view StringOf(const T& value) {
+  if constexpr (std::is_pointer_v<T>) {
+    if (value == nullptr) {
+      return {};
+    }
+  }
+  return std::string_view(value);
+}
+
+/**
+ * * @brief A streambuf that appends everything to a LogBuffer.
+ */
+class LogStreamBuf : public std::streambuf {
+ public:
+  explicit LogStreamBuf(LogBuffer* buffer) : buffer(buffer) {}
+
+ protected:
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+      buffer->Append(traits_type::to_char_type(ch));
+    }
+    return traits_type::not_eof(ch);
+  }
+  std::streamsize xsputn(const char* s, std::streamsize n) override {
+    buffer->Append(s, static_cast<size_t>(n));
+    return n;
+  }
+
+ private:
+  LogBuffer* buffer;
+};
+
+/**
+ * * @brief A record buffer together with the ostream that formats into it.
+ * * @details The ostream is only used for values that have no faster path; it
+ * is created once, so the locale setup is paid once per context instead of
+ * once per record.
+ */
+struct FormatContext {
+  FormatContext() = default;
+  FormatContext(const FormatContext&) = delete;
+  FormatContext& operator=(const FormatContext&) = delete;
+
+  /**
+   * * @brief Whether the stream still formats like a fresh one, i.e. no
+   * manipulator changed it. Values may only bypass the stream if it does.
+   */
+  bool StreamIsDefault() const {
+    return !stream_used ||
+           (stream.flags() == (std::ios_base::dec | std::ios_base::skipws) &&
+            stream.precision() == 6 && stream.width() == 0 &&
+            stream.fill() == ' ' && stream.good());
+  }
+
+  /// @brief Undo any manipulator a record applied to the stream.
+  void ResetStream() {
+    stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    stream.precision(6);
+    stream.width(0);
+    stream.fill(' ');
+    stream.clear();
+  }
+
+  LogBuffer buffer;
+  LogStreamBuf streambuf{&buffer};
+  std::ostream stream{&streambuf};
+  bool stream_used{false};
+};
+
+/**
+ * * @brief The format contexts owned by one thread.
+ * * @details A record may be built while another one of the same thread is
+ * still open, e.g. when an argument's operator<< logs by itself. Each nesting
+ * level gets its own context; deeper nesting falls back to the heap.
+ */
+class ThreadFormatContexts {
+ public:
+  static constexpr int kMaxDepth = 4;
+
+  ThreadFormatContexts() = default;
+  ~ThreadFormatContexts() { destroyed() = true; }
+
+  /// @return The contexts of the calling thread, or nullptr once they have
+  /// been destroyed at thread exit.
+  static ThreadFormatContexts* Get() {
+    if (destroyed()) {
+      return nullptr;
+    }
+    static thread_local ThreadFormatContexts contexts;
+    return &contexts;
+  }
+
+  static FormatContext* Acquire() {
+    ThreadFormatContexts* self = Get();
+    if (self == nullptr || self->depth == kMaxDepth) {
+      return new FormatContext();
+    }
+    return &self->contexts[self->depth++];
+  }
+
+  static void Release(FormatContext* context) {
+    ThreadFormatContexts* self = Get();
+    if (self == nullptr || context < self->contexts ||
+        context >= self->contexts + kMaxDepth) {
+      delete context;
+      return;
+    }
+    if (context->stream_used) {
+      context->ResetStream();
+      context->stream_used = false;
+    }
+    context->buffer.Clear();
+    --self->depth;
+  }
+
+ private:
+  static bool& destroyed() {
+    static thread_local bool value = false;
+    return value;
+  }
+
+  FormatContext contexts[kMaxDepth];
+  int depth{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_BUFFER_H
@@ -0,0 +1,147 @@
+#ifndef BASIC_LOG_CONTEXT_H
+#define BASIC_LOG_CONTEXT_H
+
+// The per-thread storage behind Logging::ScopedContext and Logging::Context.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief The fields of the scoped contexts open on a thread, rendered once
+ * for every record format.
+ * * @details Each format has a fixed region of its own that holds the fields
+ * back to back, exactly as records of that format contain them, so a record
+ * adds all of them with a single copy. Fields are pushed and popped in LIFO
+ * order; nothing is ever allocated.
+ */
+class ContextStack {
+ public:
+  /// @brief The record formats, indexed by Logging::Format.
+  static constexpr size_t kFormats = 4;
+  /// @brief Bytes of fields each format has room for.
+  static constexpr size_t kCapacity = 512;
+
+  /// @brief How far the regions are filled; what Restore goes back to.
+  struct Mark {
+    uint16_t used[kFormats];
+  };
+
+  /// @brief The calling thread's stack.
+  static ContextStack& Local() {
+    static thread_local ContextStack stack;
+    return stack;
+  }
+
+  Mark Top() const {
+    Mark mark{};
+    std::memcpy(mark.used, used, sizeof(used));
+    return mark;
+  }
+
+  /// @return false, leaving the region as it was, if bytes do not fit.
+  bool Push(size_t format, std::string_view bytes) {
+    if (bytes.size() > kCapacity - used[format]) {
+      return false;
+    }
+    std::memcpy(regions[format] + used[format], bytes.data(), bytes.size());
+    used[format] = static_cast<uint16_t>(used[format] + bytes.size());
+    return true;
+  }
+
+  /// @brief Drop everything pushed after mark was taken.
+  void Restore(const Mark& mark) {
+    std::memcpy(used, mark.used, sizeof(used));
+  }
+
+  /// @brief The fields as records of format contain them.
+  std::string_view Fields(size_t format) const {
+    return {regions[format], used[format]};
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  /// @brief Bytes of fields over all formats.
+  size_t Size() const {
+    size_t size = 0;
+    for (uint16_t bytes : used) {
+      size += bytes;
+    }
+    return size;
+  }
+
+ private:
+  friend class ContextFields;
+
+  uint16_t used[kFormats]{};
+  char regions[kFormats][kCapacity];
+};
+
+/**
+ * * @brief A copy of the fields on a ContextStack, to be put on another one.
+ * * @details Only the bytes in use are copied; a copy of an empty stack
+ * allocates nothing.
+ */
+class ContextFields {
+ public:
+  ContextFields() = default;
+
+  explicit ContextFields(const ContextStack& stack) : mark(stack.Top()) {
+    bytes.reserve(stack.Size());
+    for (size_t format = 0; format < ContextStack::kFormats; ++format) {
+      bytes.append(stack.Fields(format));
+    }
+  }
+
+  /// @brief Replace the fields of stack with these.
+  void CopyTo(ContextStack& stack) const {
+    const char* next = bytes.data();
+    for (size_t format = 0; format < ContextStack::kFormats; ++format) {
+      std::memcpy(stack.regions[format], next, mark.used[format]);
+      next += mark.used[format];
+    }
+    stack.Restore(mark);
+  }
+
+ private:
+  ContextStack::Mark mark{};
+  std::string bytes;
+};
+
+#ifdef __cpp_impl_coroutine
+template <typename T, typename = void>
+struct HasMemberCoAwait : std::false_type {};
+template <typename T>
+struct HasMemberCoAwait<
+    T, std::void_t<decltype(std::declval<T>().operator co_await())>>
+    : std::true_type {};
+
+/// @brief The awaiter co_await would use for awaitable.
+template <typename T>
+decltype(auto) GetAwaiter(T&& awaitable) {
+  if constexpr (HasMemberCoAwait<T>::value) {
+    return std::forward<T>(awaitable).operator co_await();
+  } else {
+    return std::forward<T>(awaitable);
+  }
+}
+
+/// @brief How to keep the awaiter of T: by reference for an lvalue.
+template <typename T>
+using StoredAwaiter = std::conditional_t<
+    std::is_lvalue_reference_v<decltype(GetAwaiter(std::declval<T>()))>,
+    decltype(GetAwaiter(std::declval<T>())),
+    std::remove_reference_t<decltype(GetAwaiter(std::declval<T>()))>>;
+#endif
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_CONTEXT_H
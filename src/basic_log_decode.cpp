@@ -0,0 +1,289 @@
+// Renders logs written with Logging::Format::BINARY as text.
+//
+// Usage: BasicLogDecode [FILE]...
+//
+// Reads the files in the given order, or standard input if there are none,
+// and prints the records as the text format would have. Pass every file
+// written since the last BasicConfig call: call sites are described only once.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "basic_log_binary.h"
+#include "basic_log_time.h"
+
+namespace {
+
+using basic_log::detail::BinaryReader;
+using basic_log::detail::FrameKind;
+using basic_log::detail::ValueTag;
+
+struct Site {
+  std::string level_str;
+  std::string file;
+  uint32_t line{0};
+};
+
+bool ReadSite(BinaryReader& reader, Site& site) {
+  uint8_t level = 0;
+  std::string_view level_str;
+  std::string_view file;
+  if (!reader.Get(level) || !reader.GetString(level_str) ||
+      !reader.GetString(file) || !reader.Get(site.line)) {
+    return false;
+  }
+  site.level_str = level_str;
+  site.file = file;
+  return true;
+}
+
+/// @brief Splits the input into frames.
+class FrameReader {
+ public:
+  explicit FrameReader(std::string_view bytes) : reader(bytes) {}
+
+  /// @return false at the end of the input; error is set if it is truncated.
+  bool Next(FrameKind& kind, std::string_view& payload) {
+    if (reader.Empty()) {
+      return false;
+    }
+    uint32_t size = 0;
+    if (!reader.Get(kind) || !reader.Get(size) ||
+        !reader.GetBytes(size, payload)) {
+      error = true;
+      return false;
+    }
+    return true;
+  }
+
+  bool error{false};
+
+ private:
+  BinaryReader reader;
+};
+
+class Decoder {
+ public:
+  bool AddSites(std::string_view bytes) {
+    FrameReader frames(bytes);
+    FrameKind kind;
+    std::string_view payload;
+    while (frames.Next(kind, payload)) {
+      if (kind != FrameKind::SITE) {
+        continue;
+      }
+      BinaryReader reader(payload);
+      uint32_t id = 0;
+      Site site;
+      if (!reader.Get(id) || !ReadSite(reader, site)) {
+        return false;
+      }
+      sites[id] = std::move(site);
+    }
+    return !frames.error;
+  }
+
+  bool Render(std::string_view bytes, std::ostream& out) {
+    FrameReader frames(bytes);
+    FrameKind kind;
+    std::string_view payload;
+    while (frames.Next(kind, payload)) {
+      if (kind != FrameKind::EVENT) {
+        continue;
+      }
+      line.clear();
+      if (!RenderEvent(payload)) {
+        return false;
+      }
+      line += '\n';
+      out.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+    return !frames.error;
+  }
+
+ private:
+  bool RenderEvent(std::string_view payload) {
+    BinaryReader reader(payload);
+    uint32_t id = 0;
+    int64_t nanoseconds = 0;
+    uint8_t fraction_digits = 0;
+    if (!reader.Get(id) || !reader.Get(nanoseconds) ||
+        !reader.Get(fraction_digits) || !reader.Get(float_precision)) {
+      return false;
+    }
+    Site inline_site;
+    const Site* site = &inline_site;
+    if (id == 0) {
+      if (!ReadSite(reader, inline_site)) {
+        return false;
+      }
+    } else if (auto it = sites.find(id); it != sites.end()) {
+      site = &it->second;
+    } else {
+      inline_site.level_str = "?";
+      inline_site.file = "<unknown site " + std::to_string(id) + ">";
+    }
+    line += '[';
+    line += site->level_str;
+    line += "][";
+    AppendTime(nanoseconds, fraction_digits);
+    line += "][";
+    line += site->file;
+    line += ':';
+    line += std::to_string(site->line);
+    line += "]:";
+    while (!reader.Empty()) {
+      if (!RenderValue(reader)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool RenderValue(BinaryReader& reader) {
+    uint8_t tag_byte = 0;
+    if (!reader.Get(tag_byte)) {
+      return false;
+    }
+    if ((tag_byte & basic_log::detail::kNoSpace) == 0) {
+      line += ' ';
+    }
+    auto tag =
+        static_cast<ValueTag>(tag_byte & ~basic_log::detail::kNoSpace);
+    switch (tag) {
+      case ValueTag::INT: {
+        int64_t value = 0;
+        if (!reader.Get(value)) {
+          return false;
+        }
+        line += std::to_string(value);
+        return true;
+      }
+      case ValueTag::UINT: {
+        uint64_t value = 0;
+        if (!reader.Get(value)) {
+          return false;
+        }
+        line += std::to_string(value);
+        return true;
+      }
+      case ValueTag::DOUBLE: {
+        double value = 0;
+        if (!reader.Get(value)) {
+          return false;
+        }
+        char text[basic_log::detail::kMaxNumberLength];
+        line.append(text, basic_log::detail::FormatFloat(text, value,
+                                                         float_precision));
+        return true;
+      }
+      case ValueTag::STRING: {
+        std::string_view text;
+        if (!reader.GetString(text)) {
+          return false;
+        }
+        line += text;
+        return true;
+      }
+      case ValueTag::LITERAL: {
+        uint8_t index = 0;
+        if (!reader.Get(index) ||
+            index >= std::size(basic_log::detail::kLiterals)) {
+          return false;
+        }
+        line += basic_log::detail::kLiterals[index];
+        return true;
+      }
+      case ValueTag::DURATION: {
+        int64_t count = 0;
+        uint8_t unit = 0;
+        if (!reader.Get(count) || !reader.Get(unit) ||
+            unit >= std::size(basic_log::detail::kDurationUnits)) {
+          return false;
+        }
+        line += std::to_string(count);
+        line += ' ';
+        line += basic_log::detail::kDurationUnits[unit];
+        return true;
+      }
+      case ValueTag::TIME_POINT: {
+        int64_t nanoseconds = 0;
+        if (!reader.Get(nanoseconds)) {
+          return false;
+        }
+        AppendTime(nanoseconds, 0);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void AppendTime(int64_t nanoseconds, int fraction_digits) {
+    char text[basic_log::detail::TimestampCache::kMaxLength];
+    auto time = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(nanoseconds)));
+    line.append(text, basic_log::detail::TimestampCache::Format(
+                          time, fraction_digits, text));
+  }
+
+  std::unordered_map<uint32_t, Site> sites;
+  std::string line;
+  /// @brief Of the event being rendered.
+  int8_t float_precision{6};
+};
+
+bool ReadAll(std::istream& in, std::string& bytes) {
+  bytes.assign(std::istreambuf_iterator<char>(in),
+               std::istreambuf_iterator<char>());
+  return !in.bad();
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  std::vector<std::string> inputs;
+  std::vector<std::string> names;
+  if (argc < 2) {
+    inputs.emplace_back();
+    names.emplace_back("<stdin>");
+    if (!ReadAll(std::cin, inputs.back())) {
+      std::cerr << "BasicLogDecode: cannot read standard input\n";
+      return 1;
+    }
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream file(argv[i], std::ios::binary);
+    inputs.emplace_back();
+    names.emplace_back(argv[i]);
+    if (!file || !ReadAll(file, inputs.back())) {
+      std::cerr << "BasicLogDecode: cannot read " << argv[i] << "\n";
+      return 1;
+    }
+  }
+
+  // Descriptions may follow the first records of their site, so collect all
+  // of them before rendering anything.
+  Decoder decoder;
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (!decoder.AddSites(inputs[i])) {
+      std::cerr << "BasicLogDecode: " << names[i] << " is corrupt\n";
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    if (!decoder.Render(inputs[i], std::cout)) {
+      std::cerr << "BasicLogDecode: " << names[i] << " is corrupt\n";
+      return 1;
+    }
+  }
+  return 0;
+}
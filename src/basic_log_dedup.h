@@ -0,0 +1,102 @@
+#ifndef BASIC_LOG_DEDUP_H
+#define BASIC_LOG_DEDUP_H
+
+// The suppression of repeated records behind Options::dedup_window. Every
+// LOG statement keeps a Repeats in its Logging::Site.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief A 64-bit hash of bytes, taken eight at a time.
+ * * @details Fast rather than strong: it only tells records of a statement
+ * apart, so collisions merely merge two records into one count.
+ */
+inline uint64_t HashBytes(std::string_view bytes) {
+  constexpr uint64_t kMultiplier = 0x9E3779B97F4A7C15ULL;
+  const char* next = bytes.data();
+  size_t left = bytes.size();
+  uint64_t hash = static_cast<uint64_t>(left) * kMultiplier;
+  auto mix = [&hash](uint64_t word) {
+    hash = (hash ^ word) * kMultiplier;
+    hash ^= hash >> 29;
+  };
+  for (; left >= 8; next += 8, left -= 8) {
+    uint64_t word;
+    std::memcpy(&word, next, 8);
+    mix(word);
+  }
+  if (left > 0) {
+    uint64_t word = 0;
+    std::memcpy(&word, next, left);
+    mix(word);
+  }
+  // The finalizer of MurmurHash3.
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+/**
+ * * @brief The copies of a statement's last written record that were
+ * counted instead of written.
+ * * @details Lock-free; when threads log different records at the same
+ * statement at once, a repeat may be reported with the record that
+ * replaced the one it repeated, but none is lost.
+ */
+class Repeats {
+ public:
+  /**
+   * * @brief Decide whether the record with hash, created at now, repeats
+   * the last written one within window.
+   * * @param repeated Set to the repeats to report before the record, when
+   * it is to be written.
+   * * @return true if the record is counted instead of written.
+   */
+  bool Suppress(uint64_t hash, int64_t now, int64_t window,
+                uint64_t& repeated) {
+    if (hash == last.load(std::memory_order_relaxed) &&
+        now < until.load(std::memory_order_relaxed)) {
+      count.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    last.store(hash, std::memory_order_relaxed);
+    until.store(now + window, std::memory_order_relaxed);
+    repeated = Take();
+    return false;
+  }
+
+  /// @return The repeats counted so far, which are no longer counted.
+  uint64_t Take() {
+    if (count.load(std::memory_order_relaxed) == 0) {
+      return 0;
+    }
+    return count.exchange(0, std::memory_order_relaxed);
+  }
+
+  /// @return true the first time only.
+  bool List() {
+    return !listed.load(std::memory_order_relaxed) &&
+           !listed.exchange(true, std::memory_order_relaxed);
+  }
+
+ private:
+  /// @brief The hash of the last record written.
+  std::atomic<uint64_t> last{0};
+  /// @brief Nanoseconds since the epoch at which the window ends.
+  std::atomic<int64_t> until{INT64_MIN};
+  std::atomic<uint64_t> count{0};
+  /// @brief Whether the statement is on the list Logging::Flush reports.
+  std::atomic<bool> listed{false};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_DEDUP_H
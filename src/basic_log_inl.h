@@ -0,0 +1,1232 @@
+#ifndef BASIC_LOG_INL_H
+#define BASIC_LOG_INL_H
+
+// The out-of-line part of Logging: the writer thread, the dispatch to the
+// sinks, the configuration and the calibration of the clock. basic_log.h
+// includes it, unless BASIC_LOG_COMPILED_LIB is defined; the BasicLog library
+// then compiles it once, in basic_log.cpp.
+
+#include <time.h>
+
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "basic_log.h"
+#include "basic_log_block_pool.h"
+#include "basic_log_rcu.h"
+#include "basic_log_sink.h"
+#include "basic_log_vmodule.h"
+
+/**
+ * * @brief The process-wide state of the engine that LOG statements never
+ * touch, kept here so that basic_log.h does without <mutex> and <csignal>.
+ */
+struct Logging::Engine {
+  /// @brief Serializes BasicConfig and Shutdown.
+  static inline std::mutex config_mutex;
+  /// @brief Guards VModuleRules(), LevelCaches() and the resolution of the
+  /// caches.
+  static inline std::mutex vmodule_mutex;
+  static constexpr int kCrashSignals[] = {SIGSEGV, SIGABRT, SIGBUS};
+  /// @brief The handlers InstallCrashHandlers replaced, by kCrashSignals.
+  static inline struct sigaction previous_actions[std::size(kCrashSignals)];
+  static inline std::atomic<bool> crash_handlers{false};
+  /// @brief Set by the first crash signal, so that records are written once.
+  static inline std::atomic<bool> crashed{false};
+};
+
+/**
+ * * @brief The calling thread's share of the counters behind GetStats.
+ * * @details Only the owning thread writes a shard, with relaxed loads and
+ * stores instead of read-modify-writes, and every shard has cache lines of
+ * its own. The counts of a thread are folded into the retired totals when it
+ * exits.
+ */
+class Logging::StatsShard {
+ public:
+  /// @return The calling thread's shard, or nullptr during thread exit.
+  static StatsShard* Local() {
+    // A plain pointer, so that the common case runs no guard.
+    StatsShard* shard = current;
+    return shard != nullptr ? shard : Register();
+  }
+
+  void CountRecord(LogLevel level) { Add(records[level], 1); }
+  void CountDropped(LogLevel level) { Add(dropped[level], 1); }
+  void CountSuppressed(LogLevel level) { Add(suppressed[level], 1); }
+  void CountWrite(size_t bytes) { Add(bytes_written, bytes); }
+  void CountFlush() { Add(flushes, 1); }
+
+  void RecordQueueDepth(size_t depth) {
+    if (depth > queue_high_water.load(std::memory_order_relaxed)) {
+      queue_high_water.store(depth, std::memory_order_relaxed);
+    }
+  }
+
+  void RecordEnqueue(std::chrono::steady_clock::duration latency) {
+    Add(enqueue_latency[Bucket(latency)], 1);
+  }
+  void RecordSinkWrite(std::chrono::steady_clock::duration latency) {
+    Add(sink_write_latency[Bucket(latency)], 1);
+  }
+
+  /// @return The totals over the retired and the live shards.
+  static Stats Collect() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    Stats stats = Retired();
+    for (const StatsShard* shard : Live()) {
+      shard->AddTo(stats);
+    }
+    return stats;
+  }
+
+ private:
+  StatsShard() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    Live().push_back(this);
+  }
+
+  ~StatsShard() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    AddTo(Retired());
+    auto& live = Live();
+    live.erase(std::find(live.begin(), live.end(), this));
+    current = nullptr;
+    destroyed() = true;
+  }
+
+  static StatsShard* Register() {
+    if (destroyed()) {
+      return nullptr;
+    }
+    static thread_local StatsShard shard;
+    current = &shard;
+    return current;
+  }
+
+  void AddTo(Stats& stats) const {
+    for (size_t i = 0; i < Stats::kLevels; ++i) {
+      stats.records[i] += records[i].load(std::memory_order_relaxed);
+      stats.dropped[i] += dropped[i].load(std::memory_order_relaxed);
+      stats.suppressed[i] += suppressed[i].load(std::memory_order_relaxed);
+    }
+    stats.bytes_written += bytes_written.load(std::memory_order_relaxed);
+    stats.flushes += flushes.load(std::memory_order_relaxed);
+    stats.queue_high_water =
+        std::max<uint64_t>(stats.queue_high_water,
+                           queue_high_water.load(std::memory_order_relaxed));
+    for (size_t i = 0; i < Stats::kLatencyBuckets; ++i) {
+      stats.enqueue_latency[i] +=
+          enqueue_latency[i].load(std::memory_order_relaxed);
+      stats.sink_write_latency[i] +=
+          sink_write_latency[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  /// @brief counter += n, for a counter no other thread writes.
+  static void Add(std::atomic<uint64_t>& counter, uint64_t n) {
+    counter.store(counter.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+  }
+
+  static size_t Bucket(std::chrono::steady_clock::duration latency) {
+    auto ns = static_cast<uint64_t>(std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count(),
+        0));
+    size_t bucket = 0;
+    while (ns != 0 && bucket + 1 < Stats::kLatencyBuckets) {
+      ns >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+  static bool& destroyed() {
+    static thread_local bool value = false;
+    return value;
+  }
+
+  static inline thread_local StatsShard* current{nullptr};
+
+  // Never destroyed: threads may exit after static destruction has begun.
+  static std::mutex& RegistryMutex() {
+    static auto* mutex = new std::mutex;
+    return *mutex;
+  }
+  static std::vector<const StatsShard*>& Live() {
+    static auto* live = new std::vector<const StatsShard*>;
+    return *live;
+  }
+  static Stats& Retired() {
+    static auto* retired = new Stats;
+    return *retired;
+  }
+
+  alignas(64) std::atomic<uint64_t> records[Stats::kLevels]{};
+  std::atomic<uint64_t> dropped[Stats::kLevels]{};
+  std::atomic<uint64_t> suppressed[Stats::kLevels]{};
+  std::atomic<uint64_t> bytes_written{0};
+  std::atomic<uint64_t> flushes{0};
+  std::atomic<uint64_t> queue_high_water{0};
+  std::atomic<uint64_t> enqueue_latency[Stats::kLatencyBuckets]{};
+  std::atomic<uint64_t> sink_write_latency[Stats::kLatencyBuckets]{};
+};
+
+/**
+ * * @brief Background writer behind the asynchronous mode.
+ * * @details Producers move finished records into a detail::MpscRing and only
+ * touch the mutex to wake the writer when it is parked. The writer drains up
+ * to max_batch records at a time and hands each batch to the sinks in one
+ * call. When no record arrives for a while it flushes the sinks.
+ *
+ * With per_thread_queues, every producer thread instead registers a
+ * detail::SpscRing of its own on first use, so producers never write to a
+ * shared cache line. The writer drains the queues one after another, or, with
+ * strict_ordering, merges what it drained from all of them by timestamp. A
+ * queue is closed when its thread exits and dropped once it is empty.
+ */
+class Logging::AsyncWriter {
+ public:
+  struct Entry {
+    LogLevel level{INFO};
+    /// @brief The record's text, in the block it was formatted in.
+    basic_log::detail::RecordBlock text;
+    std::chrono::system_clock::time_point time;
+  };
+
+  /// @param config The configuration the writer belongs to.
+  AsyncWriter(const Config& config, const AsyncOptions& options,
+              std::chrono::milliseconds flush_interval)
+      : config(config),
+        options(options),
+        idle_wait(flush_interval > std::chrono::milliseconds::zero() &&
+                          flush_interval < std::chrono::milliseconds(100)
+                      ? flush_interval
+                      : std::chrono::milliseconds(100)),
+        ring(options.capacity),
+        thread([this] { Run(); }) {}
+
+  ~AsyncWriter() { Stop(); }
+
+  AsyncWriter(const AsyncWriter&) = delete;
+  AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+  /// @brief Only called in a read section of config, so never once the
+  /// writer is stopped.
+  void Push(Entry&& entry) {
+    ThreadQueue* queue = options.per_thread_queues ? LocalQueue() : nullptr;
+    if (queue != nullptr) {
+      if (!queue->ring.TryPush(entry) && !HandleOverflow(*queue, entry)) {
+        CountDropped(entry.level);
+        return;
+      }
+    } else if (!ring.TryPush(entry) && !HandleOverflow(entry)) {
+      CountDropped(entry.level);
+      return;
+    }
+    Wake();
+  }
+
+  void Flush() {
+    size_t target = ring.EnqueuePos();
+    std::vector<std::pair<std::shared_ptr<ThreadQueue>, size_t>> queue_targets;
+    {
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      for (const auto& queue : queues) {
+        queue_targets.emplace_back(queue, queue->ring.EnqueuePos());
+      }
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    ++flush_waiters;
+    cv.notify_one();
+    flushed_cv.wait(lock, [&] {
+      if (stopped) {
+        return true;
+      }
+      for (const auto& [queue, queue_target] : queue_targets) {
+        if (queue->written < queue_target) {
+          return false;
+        }
+      }
+      return written_pos >= target;
+    });
+    --flush_waiters;
+  }
+
+  /// @brief Write everything queued so far and join the writer thread.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      cv.notify_one();
+    }
+    if (thread.joinable()) {
+      thread.join();
+    }
+    stopped.store(true, std::memory_order_release);
+    Drain();
+    {
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      queues.clear();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    flushed_cv.notify_all();
+  }
+
+  /**
+   * * @brief Wait for the writer to finish writing what it has taken, once
+   * crashed is set. Async-signal-safe; gives up after about 100 ms, e.g.
+   * when the writer thread itself is crashing.
+   */
+  void WaitIdle() const {
+    timespec pause{0, 1000000};
+    for (int i = 0; i < 100 && busy.load(std::memory_order_seq_cst); ++i) {
+      nanosleep(&pause, nullptr);
+    }
+  }
+
+  /**
+   * * @brief Call visit on every record not taken by the writer thread yet,
+   * without removing it. Async-signal-safe, see InstallCrashHandlers.
+   */
+  template <typename Visitor>
+  void VisitQueued(Visitor&& visit) const {
+    ring.Visit(visit);
+    for (const auto& queue : queues) {
+      queue->ring.Visit(visit);
+    }
+  }
+
+ private:
+  /// @brief The queue of one producer thread, see per_thread_queues.
+  struct ThreadQueue {
+    explicit ThreadQueue(size_t capacity) : ring(capacity) {}
+
+    basic_log::detail::SpscRing<Entry> ring;
+    /// @brief Set when the producer thread has exited.
+    std::atomic<bool> closed{false};
+    /// @brief Records of this queue written so far; guarded by mutex.
+    size_t written{0};
+  };
+
+  /// @brief A thread's registration with the current writer.
+  struct QueueHandle {
+    ~QueueHandle() {
+      Close();
+      destroyed() = true;
+    }
+
+    void Close() {
+      if (queue) {
+        queue->closed.store(true, std::memory_order_release);
+        queue.reset();
+      }
+    }
+
+    static bool& destroyed() {
+      static thread_local bool value = false;
+      return value;
+    }
+
+    /// @brief The id of the writer queue is registered with.
+    uint64_t owner{0};
+    std::shared_ptr<ThreadQueue> queue;
+  };
+
+  /// @return The calling thread's queue, registered on first use, or nullptr
+  /// during thread exit, where the shared ring is used instead.
+  ThreadQueue* LocalQueue() {
+    QueueHandle* handle = Handle();
+    if (handle == nullptr) {
+      return nullptr;
+    }
+    if (handle->owner != id) {
+      // Compared by id: a new writer may reuse a retired one's address.
+      handle->Close();
+      handle->queue = std::make_shared<ThreadQueue>(options.thread_capacity);
+      handle->owner = id;
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      queues.push_back(handle->queue);
+      queues_changed.store(true, std::memory_order_relaxed);
+    }
+    return handle->queue.get();
+  }
+
+  static QueueHandle* Handle() {
+    if (QueueHandle::destroyed()) {
+      return nullptr;
+    }
+    static thread_local QueueHandle handle;
+    return &handle;
+  }
+
+  /// @return true if the entry made it into the ring.
+  bool HandleOverflow(Entry& entry) {
+    switch (options.overflow_policy) {
+      case OverflowPolicy::DROP_NEWEST:
+        return false;
+      case OverflowPolicy::DROP_OLDEST:
+        do {
+          Entry oldest;
+          if (ring.TryPop(oldest)) {
+            CountDropped(oldest.level);
+          }
+        } while (!ring.TryPush(entry));
+        return true;
+      case OverflowPolicy::BLOCK:
+        break;
+    }
+    for (int spins = 0; !ring.TryPush(entry); ++spins) {
+      Wake();
+      Backoff(spins);
+    }
+    return true;
+  }
+
+  /// @brief HandleOverflow for a per-thread queue. Only the writer may pop
+  /// from it, so DROP_OLDEST behaves like DROP_NEWEST.
+  bool HandleOverflow(ThreadQueue& queue, Entry& entry) {
+    if (options.overflow_policy != OverflowPolicy::BLOCK) {
+      return false;
+    }
+    for (int spins = 0; !queue.ring.TryPush(entry); ++spins) {
+      Wake();
+      Backoff(spins);
+    }
+    return true;
+  }
+
+  static void CountDropped(LogLevel level) {
+    dropped_records.fetch_add(1, std::memory_order_relaxed);
+    if (StatsShard* stats = StatsShard::Local()) {
+      stats->CountDropped(level);
+    }
+  }
+
+  static void Backoff(int spins) {
+    if (spins < 64) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+
+  void Wake() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+      std::lock_guard<std::mutex> lock(mutex);
+      cv.notify_one();
+    }
+  }
+
+  void Run() {
+    std::vector<Entry> batch(options.max_batch);
+    std::vector<Record> records(options.max_batch);
+    std::vector<std::shared_ptr<ThreadQueue>> active;
+    StatsShard* stats = StatsShard::Local();
+    for (;;) {
+      BeginStep();
+      if (stats != nullptr) {
+        stats->RecordQueueDepth(QueuedApprox(active));
+      }
+      size_t count = 0;
+      while (count < options.max_batch && ring.TryPop(batch[count])) {
+        records[count] = {batch[count].level, batch[count].text.view()};
+        ++count;
+      }
+      if (count > 0) {
+        WriteToSinks(config, records.data(), count, SinkGroup::SERIALIZED);
+        Recycle(batch, count);
+      }
+      if (options.per_thread_queues) {
+        count += DrainQueues(active, batch, records);
+      }
+      if (count > 0) {
+        PublishProgress(active);
+        busy.store(false, std::memory_order_seq_cst);
+        continue;
+      }
+      PublishProgress(active);
+      busy.store(false, std::memory_order_seq_cst);
+      std::unique_lock<std::mutex> lock(mutex);
+      if (stopping) {
+        break;
+      }
+      sleeping.store(true, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      bool idle = false;
+      if (ring.SizeApprox() == 0 && QueuesEmpty(active) &&
+          flush_waiters == 0) {
+        idle = cv.wait_for(lock, idle_wait) == std::cv_status::timeout;
+      }
+      sleeping.store(false, std::memory_order_relaxed);
+      if (idle) {
+        lock.unlock();
+        BeginStep();
+        FlushSinks(config);
+        busy.store(false, std::memory_order_seq_cst);
+      }
+    }
+  }
+
+  /**
+   * * @brief Mark the writer busy, or stop it for good once a crash signal
+   * has arrived, so that the handler and the writer never write the same
+   * records; see WaitIdle.
+   */
+  void BeginStep() {
+    busy.store(true, std::memory_order_seq_cst);
+    if (Engine::crashed.load(std::memory_order_seq_cst)) {
+      busy.store(false, std::memory_order_seq_cst);
+      for (;;) {
+        std::this_thread::sleep_for(std::chrono::hours(1));
+      }
+    }
+  }
+
+  /**
+   * * @brief One pass over the per-thread queues.
+   * * @details Takes up to max_batch records from each queue. Without
+   * strict_ordering each queue's records are written as they are taken;
+   * with it, everything taken in the pass is sorted by time first.
+   * * @return The number of records written.
+   */
+  size_t DrainQueues(std::vector<std::shared_ptr<ThreadQueue>>& active,
+                     std::vector<Entry>& batch, std::vector<Record>& records) {
+    if (queues_changed.exchange(false, std::memory_order_acquire)) {
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      active = queues;
+    }
+    size_t total = 0;
+    size_t count = 0;
+    bool pruned = false;
+    for (const auto& queue : active) {
+      bool closed = queue->closed.load(std::memory_order_acquire);
+      size_t taken = 0;
+      if (count + options.max_batch > batch.size()) {
+        batch.resize(count + options.max_batch);
+      }
+      while (taken < options.max_batch &&
+             queue->ring.TryPop(batch[count + taken])) {
+        ++taken;
+      }
+      // Everything a closed queue will ever hold was visible above.
+      pruned = pruned || (closed && taken < options.max_batch);
+      count += taken;
+      if (!options.strict_ordering && count > 0) {
+        total += WriteBatch(batch, count, records);
+        count = 0;
+      }
+    }
+    if (count > 0) {
+      std::stable_sort(batch.begin(), batch.begin() + count,
+                       [](const Entry& a, const Entry& b) {
+                         return a.time < b.time;
+                       });
+      total += WriteBatch(batch, count, records);
+    }
+    if (pruned) {
+      PublishProgress(active);
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      auto drained = [](const std::shared_ptr<ThreadQueue>& queue) {
+        return queue->closed.load(std::memory_order_acquire) &&
+               queue->ring.SizeApprox() == 0;
+      };
+      queues.erase(std::remove_if(queues.begin(), queues.end(), drained),
+                   queues.end());
+      active = queues;
+    }
+    return total;
+  }
+
+  /// @brief Write batch[0, count) in chunks of max_batch.
+  size_t WriteBatch(std::vector<Entry>& batch, size_t count,
+                    std::vector<Record>& records) {
+    for (size_t start = 0; start < count; start += options.max_batch) {
+      size_t chunk = std::min(options.max_batch, count - start);
+      for (size_t i = 0; i < chunk; ++i) {
+        records[i] = {batch[start + i].level, batch[start + i].text.view()};
+      }
+      WriteToSinks(config, records.data(), chunk, SinkGroup::SERIALIZED);
+    }
+    Recycle(batch, count);
+    return count;
+  }
+
+  /// @brief Give the blocks of written records back to the pool right away
+  /// rather than when their batch slots are reused.
+  static void Recycle(std::vector<Entry>& batch, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      batch[i].text.Reset();
+    }
+  }
+
+  /// @brief Records in the ring and in the queues, as of the last pass.
+  size_t QueuedApprox(
+      const std::vector<std::shared_ptr<ThreadQueue>>& active) const {
+    size_t queued = ring.SizeApprox();
+    for (const auto& queue : active) {
+      queued += queue->ring.SizeApprox();
+    }
+    return queued;
+  }
+
+  bool QueuesEmpty(const std::vector<std::shared_ptr<ThreadQueue>>& active) {
+    if (queues_changed.load(std::memory_order_relaxed)) {
+      return false;
+    }
+    for (const auto& queue : active) {
+      if (queue->ring.SizeApprox() != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void PublishProgress(
+      const std::vector<std::shared_ptr<ThreadQueue>>& active) {
+    size_t pos = ring.DequeuePos();
+    std::lock_guard<std::mutex> lock(mutex);
+    written_pos = pos;
+    for (const auto& queue : active) {
+      queue->written = queue->ring.DequeuePos();
+    }
+    if (flush_waiters > 0) {
+      flushed_cv.notify_all();
+    }
+  }
+
+  /// @brief Write whatever is left in the ring and the queues from the
+  /// calling thread, once the writer thread has stopped.
+  void Drain() {
+    Entry entry;
+    while (ring.TryPop(entry)) {
+      Write(entry);
+    }
+    std::vector<std::shared_ptr<ThreadQueue>> snapshot;
+    {
+      std::lock_guard<std::mutex> lock(queues_mutex);
+      snapshot = queues;
+    }
+    for (const auto& queue : snapshot) {
+      while (queue->ring.TryPop(entry)) {
+        Write(entry);
+      }
+    }
+  }
+
+  void Write(const Entry& entry) {
+    Record record{entry.level, entry.text.view()};
+    WriteToSinks(config, &record, 1, SinkGroup::SERIALIZED);
+  }
+
+  const Config& config;
+  /// @brief Identifies the writer to the threads' QueueHandles.
+  const uint64_t id{next_id.fetch_add(1, std::memory_order_relaxed)};
+  static inline std::atomic<uint64_t> next_id{1};
+  const AsyncOptions options;
+  const std::chrono::milliseconds idle_wait;
+  basic_log::detail::MpscRing<Entry> ring;
+
+  /// @brief Registered per-thread queues; guarded by queues_mutex.
+  std::vector<std::shared_ptr<ThreadQueue>> queues;
+  std::mutex queues_mutex;
+  std::atomic<bool> queues_changed{false};
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::condition_variable flushed_cv;
+  std::atomic<bool> sleeping{false};
+  std::atomic<bool> stopped{false};
+  /// @brief Set while the writer takes or writes records, see BeginStep.
+  std::atomic<bool> busy{false};
+  bool stopping{false};
+  size_t flush_waiters{0};
+  size_t written_pos{0};
+
+  // Must stay last: the thread starts running in the constructor.
+  std::thread thread;
+};
+
+/**
+ * * @brief The sinks and the writer thread, replaced as a whole.
+ * * @details BasicConfig publishes a new Config through Logging::config and
+ * never modifies a published one. The logging path reads it in a
+ * basic_log::detail::Rcu read section, without taking a lock, and Publish
+ * destroys a replaced Config once no read section can see it any more.
+ */
+struct Logging::Config {
+  std::vector<std::shared_ptr<Sink>> sinks;
+  /// @brief Whether any of the sinks needs the writer thread.
+  bool serialized{true};
+  /// @brief The writer thread of the asynchronous mode, if enabled.
+  std::unique_ptr<AsyncWriter> writer;
+
+  /// @brief The configuration in effect, created on first use; valid for
+  /// the read section.
+  static Config& Current(const basic_log::detail::Rcu::Reader& reader);
+};
+
+/**
+ * * @brief Flushes the sinks periodically in the synchronous mode.
+ */
+class Logging::FlushTimer {
+ public:
+  explicit FlushTimer(std::chrono::milliseconds interval)
+      : interval(interval), thread([this] { Run(); }) {}
+
+  ~FlushTimer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!cv.wait_for(lock, interval, [this] { return stopping; })) {
+      lock.unlock();
+      FlushSinks();
+      lock.lock();
+    }
+  }
+
+  const std::chrono::milliseconds interval;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping{false};
+  // Must stay last: the thread starts running in the constructor.
+  std::thread thread;
+};
+
+BASIC_LOG_INLINE Logging::~Logging() {
+  if (field_only) {
+    basic_log::detail::ThreadFormatContexts::Release(context);
+    return;
+  }
+  auto& buffer = context->buffer;
+  if (encoding == Encoding::BINARY) {
+    basic_log::detail::BinaryWriter::EndFrame(buffer, 0);
+  } else {
+    if (encoding != Encoding::TEXT) {
+      if (message_open) {
+        buffer.Append('"');
+      }
+      if (!logfmt) {
+        buffer.Append('}');
+      }
+    }
+    buffer.Append('\n');
+  }
+  if (StatsShard* stats = StatsShard::Local()) {
+    stats->CountRecord(level);
+  }
+  if (site != nullptr && Suppressed()) {
+    if (StatsShard* stats = StatsShard::Local()) {
+      stats->CountSuppressed(level);
+    }
+    basic_log::detail::ThreadFormatContexts::Release(context);
+    return;
+  }
+  Dispatch(level, buffer, time);
+  basic_log::detail::ThreadFormatContexts::Release(context);
+  if (level == FATAL) {
+    // Nothing logged so far may be left behind in a buffer or a queue.
+    Flush();
+    std::abort();
+  }
+}
+
+BASIC_LOG_INLINE Logging& Logging::operator<<(
+    basic_log::detail::TimePointValue value) {
+  if (encoding == Encoding::BINARY) {
+    auto& buffer = context->buffer;
+    basic_log::detail::BinaryWriter::PutTag(
+        buffer, basic_log::detail::ValueTag::TIME_POINT, TakeSpace());
+    basic_log::detail::BinaryWriter::Put(buffer, value.nanoseconds);
+    return *this;
+  }
+  char text[basic_log::detail::TimestampCache::kMaxLength];
+  size_t length = basic_log::detail::TimestampCache::Format(
+      std::chrono::system_clock::time_point(
+          std::chrono::duration_cast<std::chrono::system_clock::duration>(
+              std::chrono::nanoseconds(value.nanoseconds))),
+      0, text);
+  return *this << std::string_view(text, length);
+}
+
+BASIC_LOG_INLINE void Logging::Dispatch(
+    LogLevel level, basic_log::detail::LogBuffer& buffer,
+    std::chrono::system_clock::time_point time) {
+  basic_log::detail::Rcu::Reader reader;
+  Config& current = Config::Current(reader);
+  Record record{level, buffer.view()};
+  if (AsyncWriter* writer = current.writer.get()) {
+    // Thread-safe sinks take the record straight from this thread's buffer.
+    WriteToSinks(current, &record, 1, SinkGroup::THREAD_SAFE);
+    if (current.serialized) {
+      // The writer takes over the block the record was formatted in.
+      if (latency_stats.load(std::memory_order_relaxed)) {
+        auto start = std::chrono::steady_clock::now();
+        writer->Push(
+            {level, basic_log::detail::RecordBlock::Detach(buffer), time});
+        if (StatsShard* stats = StatsShard::Local()) {
+          stats->RecordEnqueue(std::chrono::steady_clock::now() - start);
+        }
+      } else {
+        writer->Push(
+            {level, basic_log::detail::RecordBlock::Detach(buffer), time});
+      }
+    }
+  } else {
+    WriteToSinks(current, &record, 1);
+  }
+}
+
+BASIC_LOG_INLINE void Logging::DescribeSite(Site& site, uint32_t generation) {
+  uint32_t id = site.id.load(std::memory_order_acquire);
+  if (id == 0) {
+    uint32_t fresh = next_site_id.fetch_add(1, std::memory_order_relaxed);
+    // On failure id holds the ID another thread assigned first.
+    if (site.id.compare_exchange_strong(id, fresh, std::memory_order_acq_rel)) {
+      id = fresh;
+    }
+  }
+  uint32_t described = site.described_in.load(std::memory_order_acquire);
+  if (described == generation ||
+      !site.described_in.compare_exchange_strong(described, generation,
+                                                 std::memory_order_acq_rel)) {
+    return;
+  }
+  // Records of other threads may overtake the description; the decoder reads
+  // all descriptions first.
+  using basic_log::detail::BinaryWriter;
+  basic_log::detail::LogBuffer frame;
+  BinaryWriter::BeginFrame(frame, basic_log::detail::FrameKind::SITE);
+  BinaryWriter::Put(frame, id);
+  PutSite(frame, site);
+  BinaryWriter::EndFrame(frame, 0);
+  // The earliest possible time keeps it ahead of the site's records under
+  // strict_ordering.
+  Dispatch(site.level, frame, {});
+}
+
+BASIC_LOG_INLINE bool Logging::Suppressed() {
+  int64_t window = dedup_window.load(std::memory_order_relaxed);
+  if (window == 0 || level == FATAL) {
+    return false;
+  }
+  uint64_t hash = basic_log::detail::HashBytes(
+      context->buffer.view().substr(body_start));
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    time.time_since_epoch())
+                    .count();
+  uint64_t repeated = 0;
+  if (site->repeats.Suppress(hash, now, window, repeated)) {
+    if (site->repeats.List()) {
+      site->next_repeating = repeating_sites.load(std::memory_order_relaxed);
+      while (!repeating_sites.compare_exchange_weak(
+          site->next_repeating, site, std::memory_order_release,
+          std::memory_order_relaxed)) {
+      }
+    }
+    return true;
+  }
+  if (repeated != 0) {
+    ReportRepeats(*site, repeated);
+  }
+  return false;
+}
+
+BASIC_LOG_INLINE void Logging::ReportRepeats(const Site& site,
+                                             uint64_t repeated) {
+  // Not created from the Site, so that the report is never counted itself.
+  Logging(site.level, site.level_str, site.file, site.line)
+      << "last message repeated" << repeated << "times";
+}
+
+BASIC_LOG_INLINE void Logging::ReportAllRepeats() {
+  for (Site* site = repeating_sites.load(std::memory_order_acquire);
+       site != nullptr; site = site->next_repeating) {
+    if (uint64_t repeated = site->repeats.Take()) {
+      ReportRepeats(*site, repeated);
+    }
+  }
+}
+
+BASIC_LOG_INLINE Logging::Config& Logging::Config::Current(
+    const basic_log::detail::Rcu::Reader& reader) {
+  if (Config* current = reader.Load(config)) {
+    return *current;
+  }
+  // Until BasicConfig is called, records go to standard error.
+  auto* initial = new Config{{std::make_shared<ConsoleSink>()}, true, nullptr};
+  Config* expected = nullptr;
+  if (!config.compare_exchange_strong(expected, initial,
+                                      std::memory_order_seq_cst)) {
+    delete initial;
+    return *expected;
+  }
+  return *initial;
+}
+
+BASIC_LOG_INLINE void Logging::Publish(Config* next) {
+  Config* previous = config.exchange(next, std::memory_order_seq_cst);
+  site_generation.fetch_add(1, std::memory_order_relaxed);
+  if (previous == nullptr) {
+    return;
+  }
+  basic_log::detail::Rcu::Synchronize();
+  if (previous->writer) {
+    previous->writer->Stop();
+  }
+  FlushSinks(*previous);
+  delete previous;
+}
+
+BASIC_LOG_INLINE void Logging::WriteToSinks(const Config& config,
+                                            const Record* records, size_t count,
+                                            SinkGroup group) {
+  StatsShard* stats = StatsShard::Local();
+  bool timed = stats != nullptr &&
+               latency_stats.load(std::memory_order_relaxed);
+  size_t bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bytes += records[i].text.size();
+  }
+  auto write = [&](Sink& sink) {
+    std::chrono::steady_clock::time_point start;
+    if (timed) {
+      start = std::chrono::steady_clock::now();
+    }
+    sink.Write(records, count);
+    if (stats != nullptr) {
+      stats->CountWrite(bytes);
+      if (timed) {
+        stats->RecordSinkWrite(std::chrono::steady_clock::now() - start);
+      }
+    }
+  };
+  for (const auto& sink : config.sinks) {
+    if (sink->ThreadSafe()) {
+      if (group != SinkGroup::SERIALIZED) {
+        write(*sink);
+      }
+    } else if (group != SinkGroup::THREAD_SAFE) {
+      std::lock_guard<std::mutex> sink_lock(sink->mutex);
+      write(*sink);
+    }
+  }
+}
+
+BASIC_LOG_INLINE void Logging::FlushSinks() {
+  basic_log::detail::Rcu::Reader reader;
+  FlushSinks(Config::Current(reader));
+}
+
+BASIC_LOG_INLINE void Logging::FlushSinks(const Config& config) {
+  StatsShard* stats = StatsShard::Local();
+  for (const auto& sink : config.sinks) {
+    if (sink->ThreadSafe()) {
+      sink->Flush();
+    } else {
+      std::lock_guard<std::mutex> sink_lock(sink->mutex);
+      sink->Flush();
+    }
+    if (stats != nullptr) {
+      stats->CountFlush();
+    }
+  }
+}
+
+BASIC_LOG_INLINE Logging::Stats Logging::GetStats() {
+  return StatsShard::Collect();
+}
+
+BASIC_LOG_INLINE basic_log::detail::VModule& Logging::VModuleRules() {
+  static auto* rules = new basic_log::detail::VModule;
+  return *rules;
+}
+
+BASIC_LOG_INLINE std::vector<std::atomic<int>*>& Logging::LevelCaches() {
+  static auto* caches = new std::vector<std::atomic<int>*>;
+  return *caches;
+}
+
+BASIC_LOG_INLINE int Logging::ResolveLevel(std::atomic<int>& cache,
+                                           const char* file) {
+  std::lock_guard<std::mutex> lock(Engine::vmodule_mutex);
+  int resolved = VModuleRules().LevelFor(
+      file, current_level.load(std::memory_order_relaxed));
+  // Registered caches are never kLevelUnresolved again, so each is listed
+  // once.
+  if (cache.load(std::memory_order_relaxed) == kLevelUnresolved) {
+    LevelCaches().push_back(&cache);
+  }
+  cache.store(resolved, std::memory_order_relaxed);
+  return resolved;
+}
+
+BASIC_LOG_INLINE void Logging::InvalidateLevels() {
+  std::lock_guard<std::mutex> lock(Engine::vmodule_mutex);
+  for (std::atomic<int>* cache : LevelCaches()) {
+    cache->store(kLevelStale, std::memory_order_relaxed);
+  }
+}
+
+BASIC_LOG_INLINE void Logging::SetVModule(std::string_view spec) {
+  basic_log::detail::VModule rules =
+      basic_log::detail::VModule::Parse(spec, kLevelNames);
+  {
+    std::lock_guard<std::mutex> lock(Engine::vmodule_mutex);
+    VModuleRules() = std::move(rules);
+  }
+  InvalidateLevels();
+}
+
+BASIC_LOG_INLINE void Logging::BasicConfig(const Options& options) {
+  basic_log::detail::VModule rules =
+      basic_log::detail::VModule::Parse(options.vmodule, kLevelNames);
+  std::lock_guard<std::mutex> config_lock(Engine::config_mutex);
+  current_level = options.level;
+  {
+    std::lock_guard<std::mutex> lock(Engine::vmodule_mutex);
+    VModuleRules() = std::move(rules);
+  }
+  InvalidateLevels();
+  record_format = options.format;
+  latency_stats = options.latency_stats;
+  dedup_window = std::max<int64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(options.dedup_window)
+          .count(),
+      0);
+  float_precision = std::clamp(options.float_precision, -1,
+                               basic_log::detail::kMaxFloatPrecision);
+  max_container_elements = options.max_container_elements == 0
+                               ? kUnknownSize
+                               : options.max_container_elements;
+  max_container_bytes = options.max_container_bytes == 0
+                            ? kUnknownSize
+                            : options.max_container_bytes;
+  basic_log::detail::WallClock::Configure(options.clock_source);
+  switch (options.timestamp_precision) {
+    case TimestampPrecision::SECONDS:
+      fraction_digits = 0;
+      break;
+    case TimestampPrecision::MILLISECONDS:
+      fraction_digits = 3;
+      break;
+    case TimestampPrecision::MICROSECONDS:
+      fraction_digits = 6;
+      break;
+  }
+
+  auto next = std::make_unique<Config>();
+  next->sinks = options.sinks;
+  if (next->sinks.empty()) {
+    next->sinks.push_back(std::make_shared<ConsoleSink>());
+  }
+  next->serialized = false;
+  auto flush_interval = std::chrono::milliseconds::zero();
+  for (const auto& sink : next->sinks) {
+    next->serialized = next->serialized || !sink->ThreadSafe();
+    auto interval = sink->FlushInterval();
+    if (interval > std::chrono::milliseconds::zero() &&
+        (flush_interval == std::chrono::milliseconds::zero() ||
+         interval < flush_interval)) {
+      flush_interval = interval;
+    }
+  }
+
+  if (options.async.enabled) {
+    next->writer =
+        std::make_unique<AsyncWriter>(*next, options.async, flush_interval);
+  }
+  PeriodicFlush().reset();
+  Publish(next.release());
+  if (!options.async.enabled &&
+      flush_interval > std::chrono::milliseconds::zero()) {
+    PeriodicFlush() = std::make_unique<FlushTimer>(flush_interval);
+  }
+  // Make sure queued and buffered records reach the output at exit.
+  static const bool registered = (std::atexit(&Logging::Shutdown), true);
+  (void)registered;
+}
+
+BASIC_LOG_INLINE void Logging::Flush() {
+  ReportAllRepeats();
+  basic_log::detail::Rcu::Reader reader;
+  Config& current = Config::Current(reader);
+  if (current.writer) {
+    current.writer->Flush();
+  }
+  FlushSinks(current);
+}
+
+BASIC_LOG_INLINE void Logging::InstallCrashHandlers() {
+  std::lock_guard<std::mutex> config_lock(Engine::config_mutex);
+  if (Engine::crash_handlers.exchange(true)) {
+    return;
+  }
+  // Make sure the sinks exist before a handler can look at them.
+  {
+    basic_log::detail::Rcu::Reader reader;
+    Config::Current(reader);
+  }
+  for (size_t i = 0; i < std::size(Engine::kCrashSignals); ++i) {
+    struct sigaction action {};
+    action.sa_handler = &Logging::OnCrashSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_ONSTACK;
+    sigaction(Engine::kCrashSignals[i], &action, &Engine::previous_actions[i]);
+  }
+}
+
+BASIC_LOG_INLINE void Logging::OnCrashSignal(int signal) {
+  int saved_errno = errno;
+  // No read section: nothing may be waited for here.
+  Config* current = config.load(std::memory_order_acquire);
+  if (current != nullptr &&
+      !Engine::crashed.exchange(true, std::memory_order_seq_cst)) {
+    AsyncWriter* writer = current->writer.get();
+    if (writer != nullptr) {
+      writer->WaitIdle();
+    }
+    // Buffered records are older than queued ones.
+    for (const auto& sink : current->sinks) {
+      sink->EmergencyFlush();
+    }
+    if (writer != nullptr) {
+      writer->VisitQueued([current](const AsyncWriter::Entry& entry) {
+        Record record{entry.level, entry.text.view()};
+        for (const auto& sink : current->sinks) {
+          if (!sink->ThreadSafe()) {
+            sink->EmergencyWrite(record);
+          }
+        }
+      });
+    }
+  }
+  for (size_t i = 0; i < std::size(Engine::kCrashSignals); ++i) {
+    if (Engine::kCrashSignals[i] == signal) {
+      sigaction(signal, &Engine::previous_actions[i], nullptr);
+    }
+  }
+  errno = saved_errno;
+  // Delivered once the handler returns, to the previous handler.
+  ::raise(signal);
+}
+
+BASIC_LOG_INLINE void Logging::Shutdown() {
+  ReportAllRepeats();
+  std::lock_guard<std::mutex> config_lock(Engine::config_mutex);
+  PeriodicFlush().reset();
+  // Release the configured sinks so that they can finish their background
+  // work; whatever is logged later, e.g. from static destructors, goes to
+  // stderr. The last Config is never destroyed.
+  Publish(new Config{{std::make_shared<ConsoleSink>()}, true, nullptr});
+}
+
+BASIC_LOG_INLINE std::unique_ptr<Logging::FlushTimer>&
+Logging::PeriodicFlush() {
+  static std::unique_ptr<FlushTimer> timer;
+  return timer;
+}
+
+namespace basic_log {
+namespace detail {
+
+BASIC_LOG_INLINE void WallClock::Configure(ClockSource source) {
+  if (source == ClockSource::TSC && !Calibrate()) {
+    source = ClockSource::REALTIME;
+  }
+  if (source == ClockSource::STEADY) {
+    auto wall = std::chrono::system_clock::now().time_since_epoch();
+    auto steady = std::chrono::steady_clock::now().time_since_epoch();
+    steady_offset.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(wall - steady)
+            .count(),
+        std::memory_order_relaxed);
+  }
+  current_source.store(source, std::memory_order_release);
+}
+
+BASIC_LOG_INLINE bool WallClock::HasCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+  unsigned eax, ebx, ecx, edx;
+  return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) != 0 &&
+         (edx & (1u << 8)) != 0;
+#elif defined(__aarch64__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+BASIC_LOG_INLINE bool WallClock::Calibrate() {
+  while (calibrating.exchange(true, std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  bool calibrated = Measure();
+  calibrating.store(false, std::memory_order_release);
+  return calibrated;
+}
+
+BASIC_LOG_INLINE bool WallClock::Measure() {
+  if (!HasCounter()) {
+    return false;
+  }
+  uint64_t start_ticks;
+  int64_t start_nanos;
+  Sample(start_ticks, start_nanos);
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  uint64_t ticks;
+  int64_t nanos;
+  Sample(ticks, nanos);
+  if (ticks <= start_ticks || nanos <= start_nanos) {
+    return false;
+  }
+  origin_ticks = start_ticks;
+  origin_nanos = start_nanos;
+  double rate = static_cast<double>(nanos - start_nanos) /
+                static_cast<double>(ticks - start_ticks);
+  Publish({ticks, nanos, rate,
+           static_cast<int64_t>(static_cast<double>(kPeriod) / rate)});
+  return true;
+}
+
+BASIC_LOG_INLINE void WallClock::Recalibrate(const Calibration& last) {
+  uint64_t ticks;
+  int64_t nanos;
+  Sample(ticks, nanos);
+  // The rate over everything since Calibrate, which only gets better.
+  double rate = static_cast<double>(nanos - origin_nanos) /
+                static_cast<double>(ticks - origin_ticks);
+  auto period_ticks = static_cast<int64_t>(static_cast<double>(kPeriod) / rate);
+  int64_t shown = last.Convert(ticks);
+  int64_t behind = nanos - shown;
+  if (behind > -kPeriod && behind < kPeriod) {
+    // Catch up with the wall clock by the end of the next period.
+    Publish({ticks, shown,
+             rate * static_cast<double>(kPeriod + behind) / kPeriod,
+             period_ticks});
+  } else {
+    Publish({ticks, nanos, rate, period_ticks});
+  }
+}
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_INL_H
@@ -0,0 +1,340 @@
+#ifndef BASIC_LOG_MMAP_SINK_H
+#define BASIC_LOG_MMAP_SINK_H
+
+// The memory-mapped sink of the Logging class. Included by basic_log.h once
+// Logging is complete; with BASIC_LOG_COMPILED_LIB, include this header where
+// the sink is used.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "basic_log.h"
+#include "basic_log_sink.h"
+
+/**
+ * * @brief Appends records to preallocated, memory-mapped file segments.
+ * * @details Each segment is a file of options.segment_size bytes, reserved
+ * up front with posix_fallocate and mapped shared. A producer claims a byte
+ * range of the active segment with a single fetch_add and copies its record
+ * from the thread's format buffer straight into the mapping, so the record
+ * reaches the page cache without a write(2) and without any intermediate
+ * buffer. The sink is ThreadSafe, which means that even in the asynchronous
+ * mode records are appended on the thread that logs them.
+ *
+ * Segments are named "<path>.<NNNNNN>" with an increasing sequence number.
+ * The next segment is prepared on a background thread ahead of time, so the
+ * producer whose record crosses the end of the active segment only has to
+ * publish the spare one. Unmapping, syncing and truncating a full segment to
+ * the bytes actually used also happen in the background.
+ *
+ * * @note If the process dies, the active segment keeps its zero-filled tail.
+ * Records longer than a segment, and records logged while no segment can be
+ * created, are dropped and counted in DroppedCount; each such record retries
+ * the creation, so logging resumes once the cause (ENOSPC, EMFILE) is gone.
+ */
+class Logging::MmapSink : public Sink {
+ public:
+  /**
+   * * @brief When mapped data is pushed to storage with msync(2).
+   * * @details NONE leaves write-back to the kernel, ASYNC schedules it
+   * (MS_ASYNC) and SYNC waits for it (MS_SYNC). The chosen call is made when
+   * a segment is retired and whenever the sink is flushed.
+   */
+  enum class SyncPolicy { NONE, ASYNC, SYNC };
+
+  struct Options {
+    size_t segment_size{64 * 1024 * 1024};
+    SyncPolicy sync_policy{SyncPolicy::NONE};
+  };
+
+  /**
+   * * @throws std::system_error if the first segment cannot be created.
+   */
+  explicit MmapSink(std::string path) : MmapSink(std::move(path), Options()) {}
+
+  MmapSink(std::string path, const Options& options)
+      : path(std::move(path)), options(options) {
+    uint64_t sequence = 1 + LastSequence();
+    Segment* first = CreateSegment(sequence, options.segment_size);
+    if (first == nullptr) {
+      throw std::system_error(errno, std::generic_category(),
+                              "cannot map log segment " + this->path);
+    }
+    current.store(first, std::memory_order_release);
+    PrepareSpare(sequence + 1, options.segment_size);
+  }
+
+  ~MmapSink() override {
+    // Finish the background work first, then retire the last segment.
+    background.reset();
+    Segment* last = current.load(std::memory_order_acquire);
+    if (last != nullptr) {
+      Retire(last, std::min(last->reserved.load(), last->capacity));
+    }
+    if (Segment* unused = spare.load(std::memory_order_acquire)) {
+      Retire(unused, 0);
+      std::remove(unused->name.c_str());
+    }
+  }
+
+  MmapSink(const MmapSink&) = delete;
+  MmapSink& operator=(const MmapSink&) = delete;
+
+  void Write(const Record* records, size_t count) override {
+    for (size_t i = 0; i < count; ++i) {
+      Append(records[i].text);
+    }
+  }
+
+  void Flush() override {
+    if (options.sync_policy == SyncPolicy::NONE) {
+      return;
+    }
+    Segment* segment = Pin();
+    if (segment == nullptr) {
+      return;
+    }
+    size_t used = std::min(segment->reserved.load(), segment->capacity);
+    Sync(segment, used);
+    segment->writers.fetch_sub(1, std::memory_order_release);
+  }
+
+  bool ThreadSafe() const override { return true; }
+
+  /// @brief Records lost because no segment could be created.
+  uint64_t DroppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Segment {
+    uint64_t sequence{0};
+    std::string name;
+    int fd{-1};
+    char* base{nullptr};
+    size_t capacity{0};
+    std::atomic<size_t> reserved{0};
+    /// @brief Threads currently copying into, or msync-ing, the mapping.
+    std::atomic<size_t> writers{0};
+  };
+
+  void Append(std::string_view text) {
+    if (text.size() > options.segment_size) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    for (;;) {
+      Segment* segment = Pin();
+      if (segment == nullptr) {
+        if (Recover()) {
+          continue;
+        }
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      size_t offset =
+          segment->reserved.fetch_add(text.size(), std::memory_order_relaxed);
+      if (offset + text.size() <= segment->capacity) {
+        std::memcpy(segment->base + offset, text.data(), text.size());
+        segment->writers.fetch_sub(1, std::memory_order_release);
+        return;
+      }
+      segment->writers.fetch_sub(1, std::memory_order_release);
+      if (offset <= segment->capacity) {
+        // Exactly one reservation straddles the end: its owner rolls over.
+        Rollover(segment, offset);
+      } else {
+        while (current.load(std::memory_order_acquire) == segment) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+
+  /// @brief Register as a writer of the active segment.
+  Segment* Pin() {
+    for (;;) {
+      Segment* segment = current.load(std::memory_order_acquire);
+      if (segment == nullptr) {
+        return nullptr;
+      }
+      segment->writers.fetch_add(1, std::memory_order_acq_rel);
+      if (current.load(std::memory_order_acquire) == segment) {
+        return segment;
+      }
+      segment->writers.fetch_sub(1, std::memory_order_release);
+    }
+  }
+
+  void Rollover(Segment* full, size_t used) {
+    Segment* next = nullptr;
+    while ((next = spare.exchange(nullptr, std::memory_order_acq_rel)) ==
+               nullptr &&
+           !spare_failed.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+    if (next == nullptr) {
+      // Creating the spare failed and no other creation is pending; try once
+      // more before giving up.
+      next = CreateSegment(full->sequence + 1, options.segment_size);
+    }
+    if (next == nullptr) {
+      std::lock_guard<std::mutex> lock(recover_mutex);
+      recover_sequence = full->sequence + 1;
+      current.store(nullptr, std::memory_order_release);
+    } else {
+      Publish(next);
+    }
+    background->Post([this, full, used] { Retire(full, used); });
+  }
+
+  /// @brief Make next the active segment, once its successor is on the way.
+  void Publish(Segment* next) {
+    // Before the store: a producer that fills next at once must wait for
+    // this spare, not create the same segment beside it.
+    PrepareSpare(next->sequence + 1, options.segment_size);
+    current.store(next, std::memory_order_release);
+  }
+
+  /**
+   * * @brief Retry the segment that a rollover could not create.
+   * * @return Whether there is an active segment again.
+   */
+  bool Recover() {
+    std::unique_lock<std::mutex> lock(recover_mutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    if (current.load(std::memory_order_acquire) != nullptr) {
+      return true;
+    }
+    Segment* next = CreateSegment(recover_sequence, options.segment_size);
+    if (next == nullptr) {
+      return false;
+    }
+    Publish(next);
+    return true;
+  }
+
+  void PrepareSpare(uint64_t sequence, size_t capacity) {
+    if (!background) {
+      background = std::make_unique<basic_log::detail::TaskThread>();
+    }
+    spare_failed.store(false, std::memory_order_release);
+    background->Post([this, sequence, capacity] {
+      Segment* segment = CreateSegment(sequence, capacity);
+      if (segment == nullptr) {
+        spare_failed.store(true, std::memory_order_release);
+      } else {
+        spare.store(segment, std::memory_order_release);
+      }
+    });
+  }
+
+  Segment* CreateSegment(uint64_t sequence, size_t capacity) {
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%06llu",
+                  static_cast<unsigned long long>(sequence));
+    std::string name = path + suffix;
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return nullptr;
+    }
+    void* base = MAP_FAILED;
+    if (::posix_fallocate(fd, 0, static_cast<off_t>(capacity)) == 0) {
+      base = ::mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                    0);
+    }
+    if (base == MAP_FAILED) {
+      ::close(fd);
+      std::remove(name.c_str());
+      return nullptr;
+    }
+    auto segment = std::make_unique<Segment>();
+    segment->sequence = sequence;
+    segment->name = std::move(name);
+    segment->fd = fd;
+    segment->base = static_cast<char*>(base);
+    segment->capacity = capacity;
+    std::lock_guard<std::mutex> lock(segments_mutex);
+    // Kept until the sink is destroyed: a late producer may still pin it.
+    segments.push_back(std::move(segment));
+    return segments.back().get();
+  }
+
+  /// @brief Unmap a segment that is no longer current and trim it to used.
+  void Retire(Segment* segment, size_t used) {
+    while (segment->writers.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+    Sync(segment, used);
+    ::munmap(segment->base, segment->capacity);
+    if (::ftruncate(segment->fd, static_cast<off_t>(used)) != 0) {
+      // The zero-filled tail stays; nothing else to do about it.
+    }
+    ::close(segment->fd);
+    segment->fd = -1;
+  }
+
+  void Sync(Segment* segment, size_t used) {
+    if (options.sync_policy == SyncPolicy::NONE || used == 0) {
+      return;
+    }
+    ::msync(segment->base, used,
+            options.sync_policy == SyncPolicy::SYNC ? MS_SYNC : MS_ASYNC);
+  }
+
+  /// @brief The highest sequence number among existing segments of path.
+  uint64_t LastSequence() const {
+    namespace fs = std::filesystem;
+    fs::path active(path);
+    fs::path dir = active.has_parent_path() ? active.parent_path() : ".";
+    std::string prefix = active.filename().string() + ".";
+    uint64_t last = 0;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+      std::string name = entry.path().filename().string();
+      if (name.size() <= prefix.size() ||
+          name.compare(0, prefix.size(), prefix) != 0) {
+        continue;
+      }
+      const char* digits = name.c_str() + prefix.size();
+      char* end = nullptr;
+      unsigned long long value = std::strtoull(digits, &end, 10);
+      if (end != digits && *end == '\0') {
+        last = std::max<uint64_t>(last, value);
+      }
+    }
+    return last;
+  }
+
+  const std::string path;
+  const Options options;
+  std::atomic<Segment*> current{nullptr};
+  std::atomic<Segment*> spare{nullptr};
+  std::atomic<bool> spare_failed{false};
+  /// @brief Serializes Recover; recover_sequence is the segment it creates.
+  std::mutex recover_mutex;
+  uint64_t recover_sequence{0};
+  std::atomic<uint64_t> dropped{0};
+  std::mutex segments_mutex;
+  std::vector<std::unique_ptr<Segment>> segments;
+  std::unique_ptr<basic_log::detail::TaskThread> background;
+};
+
+#endif  // BASIC_LOG_MMAP_SINK_H
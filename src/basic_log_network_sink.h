@@ -0,0 +1,711 @@
+#ifndef BASIC_LOG_NETWORK_SINK_H
+#define BASIC_LOG_NETWORK_SINK_H
+
+// The network sink of the Logging class. Included by basic_log.h once Logging
+// is complete; with BASIC_LOG_COMPILED_LIB, include this header where the sink
+// is used.
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef BASIC_LOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "basic_log.h"
+#include "basic_log_sink.h"
+
+namespace basic_log {
+namespace detail {
+
+#ifdef BASIC_LOG_HAVE_ZLIB
+/// @brief data compressed with gzip; empty if zlib fails.
+inline std::string GzipString(std::string_view data) {
+  z_stream stream{};
+  if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return {};
+  }
+  std::string out(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  int result = deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return result == Z_STREAM_END ? out : std::string();
+}
+#endif
+
+/**
+ * * @brief text as an RFC 5424 header field: printable ASCII without spaces,
+ * at most max_length characters, "-" if empty.
+ */
+inline std::string SyslogField(std::string_view text, size_t max_length) {
+  if (text.empty()) {
+    return "-";
+  }
+  std::string field(text.substr(0, max_length));
+  for (char& c : field) {
+    if (c < '!' || c > '~') {
+      c = '_';
+    }
+  }
+  return field;
+}
+
+/// @brief Append text as the contents of a JSON string.
+inline void AppendJsonString(std::string& out, std::string_view text) {
+  size_t plain = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (!NeedsEscape(text[i])) {
+      continue;
+    }
+    char escaped[6];
+    out.append(text.data() + plain, i - plain);
+    out.append(escaped, EscapeChar(text[i], escaped));
+    plain = i + 1;
+  }
+  out.append(text.data() + plain, text.size() - plain);
+}
+
+/**
+ * * @brief Parse the HTTP response at the start of data.
+ * * @details Bodies are delimited by Content-Length or chunked encoding; a
+ * response with neither is taken to have no body.
+ * * @return The length of the response, 0 if it is not complete yet, or npos
+ * if data is not an HTTP response.
+ */
+inline size_t ParseHttpResponse(std::string_view data, int& status) {
+  constexpr std::string_view kVersion = "HTTP/1.";
+  if (data.substr(0, kVersion.size()) !=
+      kVersion.substr(0, std::min(data.size(), kVersion.size()))) {
+    return std::string_view::npos;
+  }
+  size_t header_end = data.find("\r\n\r\n");
+  if (header_end == std::string_view::npos) {
+    return 0;
+  }
+  if (header_end < 12) {
+    return std::string_view::npos;
+  }
+  status = (data[9] - '0') * 100 + (data[10] - '0') * 10 + (data[11] - '0');
+  std::string header(data.substr(0, header_end + 2));
+  std::transform(header.begin(), header.end(), header.begin(), [](char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+  });
+  size_t body = header_end + 4;
+  size_t length = header.find("\r\ncontent-length:");
+  if (length != std::string::npos) {
+    size_t bytes = std::strtoull(header.c_str() + length + 17, nullptr, 10);
+    return data.size() - body >= bytes ? body + bytes : 0;
+  }
+  if (header.find("\r\ntransfer-encoding: chunked") != std::string::npos) {
+    size_t last = data.find("\r\n0\r\n\r\n", body - 2);
+    return last == std::string_view::npos ? 0 : last + 7;
+  }
+  return body;
+}
+
+}  // namespace detail
+}  // namespace basic_log
+
+/**
+ * * @brief Ships records to a log collector, as syslog over UDP or TCP or as
+ * OTLP over HTTP.
+ * * @details SYSLOG_UDP sends every record as an RFC 5424 message in a
+ * datagram of its own (RFC 5426), up to 64 datagrams per sendmmsg(2).
+ * SYSLOG_TCP sends the same messages with octet-counting framing (RFC 6587).
+ * OTLP_HTTP POSTs batches as OTLP/JSON log requests to otlp_path, optionally
+ * gzip-compressed, and resends a batch on 429, 502, 503 and 504. The
+ * timestamp of a message is when the sink received it; the record's own
+ * prefix stays part of the message text.
+ *
+ * Records are collected into a batch until it reaches batch_size bytes, the
+ * oldest of them has waited flush_interval or a record at or above
+ * flush_level arrives. A full batch joins a queue of at most max_queued
+ * bytes, which also holds what was sent to the collector but not yet
+ * acknowledged. When a batch does not fit, the overflow policy drops either
+ * it or the oldest batches not yet sent; dropped records are counted in
+ * DroppedCount. BLOCK is not supported, since waiting for the network would
+ * stall the callers of LOG.
+ *
+ * The socket is non-blocking and only ever served from Write and Flush, that
+ * is from the writer thread in the asynchronous mode. Connecting, sending and
+ * reading responses never wait: whatever the socket cannot take right away
+ * stays queued for the next call, which at the latest is the periodic flush.
+ * After an error the connection is reopened, at first after reconnect_delay
+ * and then after twice the previous delay, up to max_reconnect_delay.
+ * Messages are resent from the start of the batch that was being sent,
+ * except that data the kernel had already accepted on a broken syslog TCP
+ * connection is lost. The destructor tries to deliver what is queued for at
+ * most linger.
+ *
+ * @note The collector's address is resolved once, in the constructor.
+ * Records still queued when the process crashes go to standard error.
+ */
+class Logging::NetworkSink : public Sink {
+ public:
+  enum class Protocol { SYSLOG_UDP, SYSLOG_TCP, OTLP_HTTP };
+
+  struct Options {
+    size_t batch_size{64 * 1024};
+    std::chrono::milliseconds flush_interval{200};
+    LogLevel flush_level{ERROR};
+    /// @brief Bytes of batches waiting to be sent or acknowledged.
+    size_t max_queued{4 * 1024 * 1024};
+    /// @brief DROP_NEWEST or DROP_OLDEST.
+    OverflowPolicy overflow_policy{OverflowPolicy::DROP_OLDEST};
+    std::chrono::milliseconds reconnect_delay{250};
+    std::chrono::milliseconds max_reconnect_delay{30000};
+    /// @brief How long the destructor tries to deliver the queue.
+    std::chrono::milliseconds linger{1000};
+    /// @brief The syslog APP-NAME and the OTLP service.name; empty for the
+    /// program's name.
+    std::string app_name;
+    /// @brief Syslog facility: 1 is user-level, 16 to 23 are local0-local7.
+    int facility{1};
+    /// @brief Longer syslog datagrams are truncated.
+    size_t max_datagram_size{2048};
+    std::string otlp_path{"/v1/logs"};
+    /// @brief gzip OTLP requests. Requires zlib (BASIC_LOG_HAVE_ZLIB).
+    bool compress{false};
+  };
+
+  /**
+   * * @throws std::runtime_error if host cannot be resolved.
+   */
+  NetworkSink(Protocol protocol, std::string host, uint16_t port)
+      : NetworkSink(protocol, std::move(host), port, Options()) {}
+
+  /**
+   * * @throws std::runtime_error if host cannot be resolved.
+   * * @throws std::invalid_argument if the options are not supported.
+   */
+  NetworkSink(Protocol protocol, std::string host, uint16_t port,
+              const Options& options)
+      : protocol(protocol),
+        host(std::move(host)),
+        port(port),
+        options(options),
+        delay(options.reconnect_delay) {
+    if (options.overflow_policy == OverflowPolicy::BLOCK) {
+      throw std::invalid_argument("NetworkSink cannot block on overflow");
+    }
+    if (options.compress && protocol != Protocol::OTLP_HTTP) {
+      throw std::invalid_argument("only OTLP requests can be compressed");
+    }
+#ifndef BASIC_LOG_HAVE_ZLIB
+    if (options.compress) {
+      throw std::invalid_argument("basic_log was built without zlib");
+    }
+#endif
+    Resolve();
+    BuildHeaders();
+  }
+
+  ~NetworkSink() override {
+    Seal();
+    auto deadline = std::chrono::steady_clock::now() + options.linger;
+    for (;;) {
+      Pump();
+      auto now = std::chrono::steady_clock::now();
+      if (queue.empty() || now >= deadline) {
+        break;
+      }
+      Wait(deadline - now);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  NetworkSink(const NetworkSink&) = delete;
+  NetworkSink& operator=(const NetworkSink&) = delete;
+
+  void Write(const Record* records, size_t count) override {
+    auto now = std::chrono::system_clock::now();
+    if (protocol == Protocol::OTLP_HTTP) {
+      nanos = std::to_string(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              now.time_since_epoch())
+              .count());
+    } else {
+      FormatTimestamp(now);
+    }
+    bool urgent = false;
+    for (size_t i = 0; i < count; ++i) {
+      std::string_view text = records[i].text;
+      if (!text.empty() && text.back() == '\n') {
+        text.remove_suffix(1);
+      }
+      urgent = urgent || records[i].level >= options.flush_level;
+      if (open_records == 0) {
+        opened = std::chrono::steady_clock::now();
+      }
+      Append(records[i].level, text);
+      if (open.size() >= options.batch_size) {
+        Seal();
+      }
+    }
+    if (open_records > 0 &&
+        (urgent ||
+         std::chrono::steady_clock::now() - opened >= options.flush_interval)) {
+      Seal();
+    }
+    Pump();
+  }
+
+  /// @brief Send the open batch, as far as the socket takes it right away.
+  void Flush() override {
+    Seal();
+    Pump();
+  }
+
+  std::chrono::milliseconds FlushInterval() const override {
+    return options.flush_interval;
+  }
+
+  /// @brief Records lost to the overflow policy or rejected by the collector.
+  uint64_t DroppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// @brief Syslog severities of DEBUG to FATAL.
+  static constexpr int kSyslogSeverity[] = {7, 6, 4, 3, 2};
+  /// @brief OTLP severity numbers of DEBUG to FATAL.
+  static constexpr int kOtlpSeverity[] = {5, 9, 13, 17, 21};
+  static constexpr size_t kMaxDatagrams = 64;
+  static constexpr size_t kMaxIov = 64;
+
+  /// @brief A batch ready to go out, with its framing.
+  struct Frame {
+    std::string bytes;
+    size_t records{0};
+  };
+
+  void Resolve() {
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype =
+        protocol == Protocol::SYSLOG_UDP ? SOCK_DGRAM : SOCK_STREAM;
+    addrinfo* found = nullptr;
+    std::string service = std::to_string(port);
+    int result = ::getaddrinfo(host.c_str(), service.c_str(), &hints, &found);
+    if (result != 0) {
+      throw std::runtime_error("cannot resolve " + host + ": " +
+                               ::gai_strerror(result));
+    }
+    std::memcpy(&address, found->ai_addr, found->ai_addrlen);
+    address_length = found->ai_addrlen;
+    ::freeaddrinfo(found);
+  }
+
+  void BuildHeaders() {
+    char name[256] = {};
+    ::gethostname(name, sizeof(name) - 1);
+    std::string app = options.app_name;
+#ifdef __GLIBC__
+    if (app.empty()) {
+      app = program_invocation_short_name;
+    }
+#endif
+    if (protocol != Protocol::OTLP_HTTP) {
+      // " HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA ".
+      syslog_header = ' ' + basic_log::detail::SyslogField(name, 255) + ' ' +
+                      basic_log::detail::SyslogField(app, 48) + ' ' +
+                      std::to_string(::getpid()) + " - - ";
+      return;
+    }
+    otlp_prefix = R"({"resourceLogs":[{"resource":{"attributes":[)"
+                  R"({"key":"service.name","value":{"stringValue":")";
+    basic_log::detail::AppendJsonString(otlp_prefix, app);
+    otlp_prefix += R"("}},{"key":"host.name","value":{"stringValue":")";
+    basic_log::detail::AppendJsonString(otlp_prefix, name);
+    otlp_prefix += R"("}}]},"scopeLogs":[{"scope":{"name":"basic_log"},)"
+                   R"("logRecords":[)";
+    bool literal = host.find(':') != std::string::npos;
+    http_header = "POST " + options.otlp_path + " HTTP/1.1\r\nHost: " +
+                  (literal ? '[' + host + ']' : host) + ':' +
+                  std::to_string(port) +
+                  "\r\nContent-Type: application/json\r\n";
+    if (options.compress) {
+      http_header += "Content-Encoding: gzip\r\n";
+    }
+  }
+
+  /// @brief RFC 3339 UTC time with microseconds, as syslog messages carry.
+  void FormatTimestamp(std::chrono::system_clock::time_point now) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                      now.time_since_epoch())
+                      .count();
+    std::time_t seconds = static_cast<std::time_t>(micros / 1000000);
+    std::tm utc{};
+    gmtime_r(&seconds, &utc);
+    char text[40];
+    size_t length =
+        std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(text + length, sizeof(text) - length, ".%06dZ",
+                  static_cast<int>(micros % 1000000));
+    timestamp = text;
+  }
+
+  /// @brief Add a record to the open batch, or queue its datagram.
+  void Append(LogLevel level, std::string_view text) {
+    if (protocol == Protocol::OTLP_HTTP) {
+      if (open_records > 0) {
+        open += ',';
+      }
+      open += R"({"timeUnixNano":")";
+      open += nanos;
+      open += R"(","observedTimeUnixNano":")";
+      open += nanos;
+      open += R"(","severityNumber":)";
+      open += std::to_string(kOtlpSeverity[level]);
+      open += R"(,"severityText":")";
+      open += kLevelNames[level];
+      open += R"(","body":{"stringValue":")";
+      basic_log::detail::AppendJsonString(open, text);
+      open += "\"}}";
+      ++open_records;
+      return;
+    }
+    message = '<' +
+              std::to_string(options.facility * 8 + kSyslogSeverity[level]) +
+              ">1 " + timestamp + syslog_header;
+    if (protocol == Protocol::SYSLOG_UDP) {
+      size_t room = options.max_datagram_size > message.size()
+                        ? options.max_datagram_size - message.size()
+                        : 0;
+      message.append(text.substr(0, room));
+      Enqueue(Frame{std::move(message), 1});
+      return;
+    }
+    message.append(text);
+    open += std::to_string(message.size());
+    open += ' ';
+    open += message;
+    ++open_records;
+  }
+
+  /// @brief Move the open batch to the queue.
+  void Seal() {
+    if (open_records == 0) {
+      return;
+    }
+    Frame frame;
+    frame.records = open_records;
+    if (protocol == Protocol::OTLP_HTTP) {
+      std::string body = otlp_prefix + open + "]}]}]}";
+#ifdef BASIC_LOG_HAVE_ZLIB
+      if (options.compress) {
+        body = basic_log::detail::GzipString(body);
+      }
+#endif
+      frame.bytes = http_header + "Content-Length: " +
+                    std::to_string(body.size()) + "\r\n\r\n" + body;
+    } else {
+      frame.bytes = open;
+    }
+    open.clear();
+    open_records = 0;
+    Enqueue(std::move(frame));
+  }
+
+  void Enqueue(Frame frame) {
+    if (options.overflow_policy == OverflowPolicy::DROP_OLDEST) {
+      // What is on the wire stays, the oldest batch after it goes.
+      size_t busy = unacked + (offset > 0 ? 1 : 0);
+      while (queued + frame.bytes.size() > options.max_queued &&
+             queue.size() > busy) {
+        auto oldest = queue.begin() + static_cast<ptrdiff_t>(busy);
+        Drop(*oldest);
+        queue.erase(oldest);
+      }
+    }
+    if (queued + frame.bytes.size() > options.max_queued) {
+      dropped.fetch_add(frame.records, std::memory_order_relaxed);
+      return;
+    }
+    queued += frame.bytes.size();
+    queue.push_back(std::move(frame));
+  }
+
+  void Drop(const Frame& frame) {
+    dropped.fetch_add(frame.records, std::memory_order_relaxed);
+    queued -= frame.bytes.size();
+  }
+
+  /// @brief Make whatever progress the socket allows without waiting.
+  void Pump() {
+    if (queue.empty() || !Connect()) {
+      return;
+    }
+    if (protocol == Protocol::OTLP_HTTP && !ReadResponses()) {
+      return;
+    }
+    if (protocol == Protocol::SYSLOG_UDP) {
+      SendDatagrams();
+    } else {
+      SendStream();
+    }
+  }
+
+  /// @return Whether the socket is connected.
+  bool Connect() {
+    if (fd < 0) {
+      if (std::chrono::steady_clock::now() < next_attempt) {
+        return false;
+      }
+      int type = protocol == Protocol::SYSLOG_UDP ? SOCK_DGRAM : SOCK_STREAM;
+      fd = ::socket(address.ss_family, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (fd < 0) {
+        Disconnect();
+        return false;
+      }
+      if (::connect(fd, reinterpret_cast<const sockaddr*>(&address),
+                    address_length) == 0) {
+        return true;
+      }
+      if (errno != EINPROGRESS) {
+        Disconnect();
+        return false;
+      }
+      connecting = true;
+    }
+    if (!connecting) {
+      return true;
+    }
+    pollfd ready{fd, POLLOUT, 0};
+    if (::poll(&ready, 1, 0) <= 0) {
+      return false;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 ||
+        error != 0) {
+      Disconnect();
+      return false;
+    }
+    connecting = false;
+    return true;
+  }
+
+  /// @brief Close the socket; everything unacknowledged is sent again.
+  void Disconnect() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    fd = -1;
+    connecting = false;
+    unacked = 0;
+    offset = 0;
+    response.clear();
+    next_attempt = std::chrono::steady_clock::now() + delay;
+    delay = std::min(delay * 2, options.max_reconnect_delay);
+  }
+
+  /// @brief The front batch not yet sent has gone out in full.
+  void Sent() {
+    delay = options.reconnect_delay;
+    offset = 0;
+    if (protocol == Protocol::OTLP_HTTP) {
+      ++unacked;
+      return;
+    }
+    queued -= queue.front().bytes.size();
+    queue.pop_front();
+  }
+
+  void SendDatagrams() {
+    while (!queue.empty()) {
+      size_t batch = std::min(queue.size(), kMaxDatagrams);
+      iov.resize(batch);
+      headers.assign(batch, mmsghdr{});
+      for (size_t i = 0; i < batch; ++i) {
+        iov[i] = {&queue[i].bytes[0], queue[i].bytes.size()};
+        headers[i].msg_hdr.msg_iov = &iov[i];
+        headers[i].msg_hdr.msg_iovlen = 1;
+      }
+      int sent = ::sendmmsg(fd, headers.data(), static_cast<unsigned>(batch),
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (sent < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return;
+        }
+        if (errno == EMSGSIZE) {
+          // Never going to fit; max_datagram_size is too large.
+          Drop(queue.front());
+          queue.pop_front();
+          continue;
+        }
+        Disconnect();
+        return;
+      }
+      for (int i = 0; i < sent; ++i) {
+        Sent();
+      }
+    }
+  }
+
+  void SendStream() {
+    while (unacked < queue.size()) {
+      iov.clear();
+      for (size_t i = unacked; i < queue.size() && iov.size() < kMaxIov; ++i) {
+        size_t skip = i == unacked ? offset : 0;
+        iov.push_back({&queue[i].bytes[skip], queue[i].bytes.size() - skip});
+      }
+      msghdr header{};
+      header.msg_iov = iov.data();
+      header.msg_iovlen = iov.size();
+      ssize_t sent = ::sendmsg(fd, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+      if (sent < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          Disconnect();
+        }
+        return;
+      }
+      auto left = static_cast<size_t>(sent);
+      while (left > 0) {
+        size_t rest = queue[unacked].bytes.size() - offset;
+        if (left < rest) {
+          offset += left;
+          break;
+        }
+        left -= rest;
+        Sent();
+      }
+    }
+  }
+
+  /**
+   * * @brief Match the responses received so far with the requests sent.
+   * * @return false if the connection had to be closed.
+   */
+  bool ReadResponses() {
+    bool closed = false;
+    char chunk[4096];
+    for (;;) {
+      ssize_t n = ::recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+      if (n > 0) {
+        response.append(chunk, static_cast<size_t>(n));
+        continue;
+      }
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+      break;
+    }
+    while (unacked > 0) {
+      int status = 0;
+      size_t length = basic_log::detail::ParseHttpResponse(response, status);
+      if (length == 0) {
+        break;
+      }
+      if (length == std::string::npos || status == 429 ||
+          (status >= 502 && status <= 504)) {
+        // Comes back after the reconnect delay.
+        Disconnect();
+        return false;
+      }
+      response.erase(0, length);
+      if (status < 200) {
+        // Interim (100 Continue, 103 Early Hints): the final one follows.
+        continue;
+      }
+      if (status >= 300) {
+        dropped.fetch_add(queue.front().records, std::memory_order_relaxed);
+      }
+      --unacked;
+      queued -= queue.front().bytes.size();
+      queue.pop_front();
+    }
+    if (closed) {
+      Disconnect();
+      return false;
+    }
+    return true;
+  }
+
+  /// @brief Wait at most timeout for the socket to make progress.
+  void Wait(std::chrono::steady_clock::duration timeout) {
+    if (fd < 0) {
+      timeout =
+          std::min(timeout, next_attempt - std::chrono::steady_clock::now());
+    }
+    auto millis =
+        std::chrono::ceil<std::chrono::milliseconds>(timeout).count();
+    pollfd ready{fd, 0, 0};
+    if (connecting || unacked < queue.size()) {
+      ready.events |= POLLOUT;
+    }
+    if (unacked > 0) {
+      ready.events |= POLLIN;
+    }
+    ::poll(fd < 0 ? nullptr : &ready, fd < 0 ? 0 : 1,
+           static_cast<int>(std::max<decltype(millis)>(millis, 1)));
+  }
+
+  const Protocol protocol;
+  const std::string host;
+  const uint16_t port;
+  const Options options;
+  sockaddr_storage address{};
+  socklen_t address_length{0};
+  std::string syslog_header;
+  std::string otlp_prefix;
+  std::string http_header;
+
+  /// @brief The time of the records being written, as syslog or OTLP has it.
+  std::string timestamp;
+  std::string nanos;
+  std::string message;
+  std::string open;
+  size_t open_records{0};
+  std::chrono::steady_clock::time_point opened;
+
+  std::deque<Frame> queue;
+  /// @brief Bytes in queue.
+  size_t queued{0};
+  /// @brief Requests at the front of queue waiting for their response.
+  size_t unacked{0};
+  /// @brief Bytes of the first unsent batch already sent.
+  size_t offset{0};
+  std::string response;
+  std::vector<iovec> iov;
+  std::vector<mmsghdr> headers;
+
+  int fd{-1};
+  bool connecting{false};
+  std::chrono::steady_clock::time_point next_attempt;
+  std::chrono::milliseconds delay;
+  std::atomic<uint64_t> dropped{0};
+};
+
+#endif  // BASIC_LOG_NETWORK_SINK_H
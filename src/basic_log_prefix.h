@@ -0,0 +1,89 @@
+#ifndef BASIC_LOG_PREFIX_H
+#define BASIC_LOG_PREFIX_H
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * * @brief Whether records name the source file by its base name only.
+ * * @details 1 (the default) strips everything up to the last path separator
+ * of __FILE__ at compile time; 0 keeps the path as the compiler passed it.
+ * Usually set through the CMake option of the same name.
+ */
+#ifndef BASIC_LOG_STRIP_PATH
+#define BASIC_LOG_STRIP_PATH 1
+#endif
+
+namespace basic_log {
+namespace detail {
+
+/// @brief The part of path after the last '/' or '\'.
+constexpr std::string_view Basename(std::string_view path) {
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string_view::npos ? path : path.substr(slash + 1);
+}
+
+/**
+ * * @brief The constant parts of a call site's text prefix,
+ * "[LEVEL][" and "][file:line]:", rendered at compile time.
+ * * @details The timestamp goes between Head and Tail. N only has to be large
+ * enough, see the LOG macros.
+ */
+template <size_t N>
+class SitePrefix {
+ public:
+  constexpr SitePrefix(std::string_view level_str, std::string_view path,
+                       int line)
+      : file(BASIC_LOG_STRIP_PATH ? Basename(path) : path) {
+    Append("[");
+    Append(level_str);
+    Append("][");
+    head_length = length;
+    Append("][");
+    Append(file);
+    Append(":");
+    AppendNumber(line);
+    Append("]:");
+  }
+
+  constexpr std::string_view Head() const { return {text, head_length}; }
+  constexpr std::string_view Tail() const {
+    return {text + head_length, length - head_length};
+  }
+
+  /// @brief path, stripped according to BASIC_LOG_STRIP_PATH.
+  const std::string_view file;
+
+ private:
+  constexpr void Append(std::string_view part) {
+    for (char c : part) {
+      text[length++] = c;
+    }
+  }
+
+  constexpr void AppendNumber(int value) {
+    char digits[12]{};
+    size_t count = 0;
+    unsigned magnitude = value < 0 ? 0u - static_cast<unsigned>(value)
+                                   : static_cast<unsigned>(value);
+    do {
+      digits[count++] = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+    if (value < 0) {
+      text[length++] = '-';
+    }
+    while (count > 0) {
+      text[length++] = digits[--count];
+    }
+  }
+
+  char text[N]{};
+  size_t length{0};
+  size_t head_length{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_PREFIX_H
@@ -0,0 +1,78 @@
+#ifndef BASIC_LOG_RATE_LIMIT_H
+#define BASIC_LOG_RATE_LIMIT_H
+
+// The conditions behind LOG_EVERY_N, LOG_FIRST_N, LOG_EVERY_T and
+// LOG_SAMPLED. Each macro expansion owns its state through
+// BASIC_LOG_SITE_STATE, see basic_log.h.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace basic_log {
+namespace detail {
+
+/// @brief true on the 1st, (n+1)th, (2n+1)th... call.
+inline bool EveryN(std::atomic<uint64_t>& count, int64_t n) {
+  uint64_t seen = count.fetch_add(1, std::memory_order_relaxed);
+  return n <= 1 || seen % static_cast<uint64_t>(n) == 0;
+}
+
+/// @brief true on the first n calls. Stops touching the counter afterwards.
+inline bool FirstN(std::atomic<uint64_t>& count, int64_t n) {
+  if (n <= 0 || count.load(std::memory_order_relaxed) >=
+                    static_cast<uint64_t>(n)) {
+    return false;
+  }
+  return count.fetch_add(1, std::memory_order_relaxed) <
+         static_cast<uint64_t>(n);
+}
+
+/**
+ * * @brief true on the first call and then at most once per period.
+ * * @param next Steady clock nanoseconds before which nothing is logged.
+ */
+template <typename Rep, typename Period>
+inline bool EveryT(std::atomic<int64_t>& next,
+                   std::chrono::duration<Rep, Period> period) {
+  int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch())
+                    .count();
+  int64_t due = next.load(std::memory_order_relaxed);
+  if (now < due) {
+    return false;
+  }
+  // Of the threads that find the period over, only one logs.
+  return next.compare_exchange_strong(
+      due,
+      now + std::chrono::duration_cast<std::chrono::nanoseconds>(period)
+                .count(),
+      std::memory_order_relaxed);
+}
+
+/**
+ * * @brief true with probability p.
+ * * @details Uses a per-thread xorshift64* generator, seeded from the
+ * thread's address space and the clock; not suitable for anything but
+ * sampling.
+ */
+inline bool Sampled(double p) {
+  static thread_local uint64_t state = 0;
+  if (state == 0) {
+    state = (reinterpret_cast<uintptr_t>(&state) ^
+             static_cast<uint64_t>(
+                 std::chrono::steady_clock::now().time_since_epoch().count())) |
+            1;
+  }
+  state ^= state >> 12;
+  state ^= state << 25;
+  state ^= state >> 27;
+  uint64_t random = state * 0x2545F4914F6CDD1DULL;
+  // The top 53 bits as a double in [0, 1).
+  return static_cast<double>(random >> 11) * 0x1.0p-53 < p;
+}
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_RATE_LIMIT_H
@@ -0,0 +1,187 @@
+#ifndef BASIC_LOG_RCU_H
+#define BASIC_LOG_RCU_H
+
+// Epoch-based read-copy-update for the state the logging path reads.
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief Epoch-based reclamation of state that is replaced as a whole.
+ * * @details A writer publishes new state through an atomic pointer and
+ * calls Synchronize, which waits until every read section that may have seen
+ * the old state has ended; after that the old state can be destroyed.
+ *
+ * A reader announces the epoch it started in, in a cache line of its own
+ * thread: entering and leaving a read section are a load and a store each,
+ * without any lock, loop or shared write, so readers are wait-free. Read
+ * sections nest. Threads that log during their own exit, after their slot is
+ * gone, count themselves in a shared counter instead.
+ */
+class Rcu {
+  class Slot;
+
+ public:
+  /// @brief A read section, for the lifetime of the object.
+  class Reader {
+   public:
+    Reader() : slot(Slot::Local()) {
+      if (slot != nullptr) {
+        slot->Enter();
+      } else {
+        unregistered.fetch_add(1, std::memory_order_seq_cst);
+      }
+    }
+
+    ~Reader() {
+      if (slot != nullptr) {
+        slot->Leave();
+      } else {
+        unregistered.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    /// @brief The state published through pointer, valid for the section.
+    template <typename T>
+    T* Load(const std::atomic<T*>& pointer) const {
+      // Ordered after the announcement; pairs with Synchronize.
+      return pointer.load(std::memory_order_seq_cst);
+    }
+
+   private:
+    Slot* const slot;
+  };
+
+  /**
+   * * @brief Wait until every read section that began before the call has
+   * ended. Publish the new state, with a seq_cst store, first.
+   * * @note Must not be called inside a read section of the calling thread.
+   */
+  static void Synchronize() {
+    uint64_t target = epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::vector<Slot*> slots;
+    {
+      std::lock_guard<std::mutex> lock(RegistryMutex());
+      slots = All();
+    }
+    // Without the lock: a reader may start a thread that registers.
+    for (const Slot* slot : slots) {
+      for (;;) {
+        uint64_t started = slot->started.load(std::memory_order_seq_cst);
+        if (started == 0 || started >= target) {
+          break;
+        }
+        std::this_thread::yield();
+      }
+    }
+    while (unregistered.load(std::memory_order_seq_cst) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  /// @brief The read sections of one thread; reused after it exits.
+  class alignas(64) Slot {
+   public:
+    /// @return The calling thread's slot, or nullptr during thread exit.
+    static Slot* Local() {
+      // A plain pointer, so that the common case runs no guard.
+      Slot* slot = current;
+      return slot != nullptr ? slot : Register();
+    }
+
+    void Enter() {
+      if (depth++ == 0) {
+        started.store(epoch.load(std::memory_order_acquire),
+                      std::memory_order_seq_cst);
+      }
+    }
+
+    void Leave() {
+      if (--depth == 0) {
+        started.store(0, std::memory_order_release);
+      }
+    }
+
+    /// @brief The epoch the outermost open read section began in; 0 if none.
+    std::atomic<uint64_t> started{0};
+
+   private:
+    /// @brief Gives the slot back when its thread exits.
+    struct Owner {
+      ~Owner() {
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        slot->owned = false;
+        current = nullptr;
+        destroyed() = true;
+      }
+
+      Slot* slot;
+    };
+
+    static Slot* Register() {
+      if (destroyed()) {
+        return nullptr;
+      }
+      Slot* slot = nullptr;
+      {
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        for (Slot* free : All()) {
+          if (!free->owned) {
+            slot = free;
+            break;
+          }
+        }
+        if (slot == nullptr) {
+          // Never freed: Synchronize may still be looking at it.
+          slot = new Slot;
+          All().push_back(slot);
+        }
+        slot->owned = true;
+      }
+      static thread_local Owner owner{slot};
+      current = slot;
+      return slot;
+    }
+
+    static bool& destroyed() {
+      static thread_local bool value = false;
+      return value;
+    }
+
+    static inline thread_local Slot* current{nullptr};
+
+    /// @brief Read sections open on the owning thread; only it touches this.
+    int depth{0};
+    /// @brief Whether a thread uses the slot; guarded by RegistryMutex.
+    bool owned{false};
+  };
+
+  /// @brief Guards All() and Slot::owned. Never destroyed, like the slots.
+  static std::mutex& RegistryMutex() {
+    static auto* mutex = new std::mutex;
+    return *mutex;
+  }
+  static std::vector<Slot*>& All() {
+    static auto* all = new std::vector<Slot*>;
+    return *all;
+  }
+
+  static inline std::atomic<uint64_t> epoch{1};
+  /// @brief Read sections of threads without a slot.
+  static inline std::atomic<uint64_t> unregistered{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_RCU_H
@@ -0,0 +1,234 @@
+#ifndef BASIC_LOG_RING_H
+#define BASIC_LOG_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief A bounded, lock-free multi-producer queue.
+ * * @details Every slot carries a sequence number that tells producers and
+ * consumers whose turn it is, so a push or a pop is a single CAS on the shared
+ * position plus a release store on the slot (D. Vyukov's bounded queue). The
+ * logger uses it as an MPSC ring: many threads push finished records and one
+ * writer thread pops them. Pops are safe from any thread as well, which is what
+ * the drop-oldest overflow policy relies on.
+ * * @note The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class MpscRing {
+ public:
+  explicit MpscRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask = size - 1;
+    slots.reset(new Slot[size]);
+    for (size_t i = 0; i < size; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  /**
+   * * @brief Move value into the ring.
+   * * @return false if the ring is full; value is left untouched.
+   */
+  bool TryPush(T& value) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots[pos & mask];
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          slot.value = std::move(value);
+          slot.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * * @brief Move the oldest element out of the ring.
+   * * @return false if the ring is empty.
+   */
+  bool TryPop(T& value) {
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot& slot = slots[pos & mask];
+      size_t seq = slot.sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          value = std::move(slot.value);
+          slot.sequence.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t Capacity() const { return mask + 1; }
+
+  /**
+   * * @brief Call visit on every element pushed and not yet popped, oldest
+   * first, without removing them.
+   * * @details Takes no lock and allocates nothing, so that it can run in a
+   * signal handler. Elements popped concurrently may be skipped or seen
+   * while they are moved out.
+   */
+  template <typename Visitor>
+  void Visit(Visitor&& visit) const {
+    size_t pos = dequeue_pos.load(std::memory_order_acquire);
+    size_t tail = enqueue_pos.load(std::memory_order_acquire);
+    for (; pos < tail; ++pos) {
+      const Slot& slot = slots[pos & mask];
+      if (slot.sequence.load(std::memory_order_acquire) == pos + 1) {
+        visit(slot.value);
+      }
+    }
+  }
+
+  /// @brief Number of pushes that have claimed a slot so far.
+  size_t EnqueuePos() const {
+    return enqueue_pos.load(std::memory_order_seq_cst);
+  }
+  /// @brief Number of pops that have claimed a slot so far.
+  size_t DequeuePos() const {
+    return dequeue_pos.load(std::memory_order_seq_cst);
+  }
+  size_t SizeApprox() const {
+    size_t head = DequeuePos();
+    size_t tail = EnqueuePos();
+    return tail > head ? tail - head : 0;
+  }
+
+ private:
+  struct alignas(64) Slot {
+    std::atomic<size_t> sequence{0};
+    T value{};
+  };
+
+  std::unique_ptr<Slot[]> slots;
+  size_t mask{0};
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+/**
+ * * @brief A bounded, lock-free single-producer single-consumer queue.
+ * * @details The producer and the consumer each own one position and keep a
+ * cached copy of the other's, so in the common case a push or a pop touches no
+ * cache line the other side writes. Used for the per-thread queues of the
+ * asynchronous mode.
+ * * @note The capacity is rounded up to a power of two.
+ */
+template <typename T>
+class SpscRing {
+ public:
+  explicit SpscRing(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask = size - 1;
+    slots.reset(new T[size]);
+  }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  /**
+   * * @brief Move value into the ring. Producer only.
+   * * @return false if the ring is full; value is left untouched.
+   */
+  bool TryPush(T& value) {
+    size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+    if (tail - cached_dequeue_pos > mask) {
+      cached_dequeue_pos = dequeue_pos.load(std::memory_order_acquire);
+      if (tail - cached_dequeue_pos > mask) {
+        return false;
+      }
+    }
+    slots[tail & mask] = std::move(value);
+    enqueue_pos.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * * @brief Move the oldest element out of the ring. Consumer only.
+   * * @return false if the ring is empty.
+   */
+  bool TryPop(T& value) {
+    size_t head = dequeue_pos.load(std::memory_order_relaxed);
+    if (head == cached_enqueue_pos) {
+      cached_enqueue_pos = enqueue_pos.load(std::memory_order_acquire);
+      if (head == cached_enqueue_pos) {
+        return false;
+      }
+    }
+    value = std::move(slots[head & mask]);
+    dequeue_pos.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Capacity() const { return mask + 1; }
+
+  /// @brief Like MpscRing::Visit; safe from any thread, on the same terms.
+  template <typename Visitor>
+  void Visit(Visitor&& visit) const {
+    size_t pos = dequeue_pos.load(std::memory_order_acquire);
+    size_t tail = enqueue_pos.load(std::memory_order_acquire);
+    for (; pos < tail; ++pos) {
+      visit(slots[pos & mask]);
+    }
+  }
+
+  /// @brief Number of pushes so far.
+  size_t EnqueuePos() const {
+    return enqueue_pos.load(std::memory_order_seq_cst);
+  }
+  /// @brief Number of pops so far.
+  size_t DequeuePos() const {
+    return dequeue_pos.load(std::memory_order_seq_cst);
+  }
+  size_t SizeApprox() const {
+    size_t head = DequeuePos();
+    size_t tail = EnqueuePos();
+    return tail > head ? tail - head : 0;
+  }
+
+ private:
+  std::unique_ptr<T[]> slots;
+  size_t mask{0};
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  /// @brief The producer's view of dequeue_pos.
+  size_t cached_dequeue_pos{0};
+  alignas(64) std::atomic<size_t> dequeue_pos{0};
+  /// @brief The consumer's view of enqueue_pos.
+  size_t cached_enqueue_pos{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_RING_H
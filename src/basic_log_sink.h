@@ -0,0 +1,580 @@
+// Sinks of the Logging class. Included by basic_log.h once Logging is
+// complete; with BASIC_LOG_COMPILED_LIB, include this header where the sinks
+// are used.
+
+// Ahead of the guard: without BASIC_LOG_COMPILED_LIB, basic_log.h includes
+// this header in turn and needs the sinks right after it.
+#include "basic_log.h"
+
+#ifndef BASIC_LOG_SINK_H
+#define BASIC_LOG_SINK_H
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef BASIC_LOG_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief writev until every byte is written or a hard error occurs.
+ * * @details Retries on EINTR and on short writes, and splits batches larger
+ * than IOV_MAX. iov is modified in place.
+ * * @return false if the descriptor reported an error.
+ */
+inline bool WriteFully(int fd, iovec* iov, size_t count) {
+  while (count > 0) {
+    int chunk = static_cast<int>(count < IOV_MAX ? count : IOV_MAX);
+    ssize_t written = ::writev(fd, iov, chunk);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    auto left = static_cast<size_t>(written);
+    while (count > 0 && left >= iov->iov_len) {
+      left -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (left > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+  return true;
+}
+
+/// @brief WriteFully for a single block; async-signal-safe.
+inline bool WriteFully(int fd, std::string_view text) {
+  iovec iov{const_cast<char*>(text.data()), text.size()};
+  return WriteFully(fd, &iov, 1);
+}
+
+/**
+ * * @brief A thread that runs queued tasks one after another.
+ * * @details Used for work that must stay off the logging path, such as
+ * compressing rotated files. The destructor finishes the pending tasks.
+ */
+class TaskThread {
+ public:
+  TaskThread() : thread([this] { Run(); }) {}
+
+  ~TaskThread() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  TaskThread(const TaskThread&) = delete;
+  TaskThread& operator=(const TaskThread&) = delete;
+
+  void Post(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      tasks.push_back(std::move(task));
+    }
+    cv.notify_one();
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+      cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+      if (tasks.empty()) {
+        return;
+      }
+      auto task = std::move(tasks.front());
+      tasks.pop_front();
+      lock.unlock();
+      task();
+      lock.lock();
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> tasks;
+  bool stopping{false};
+  // Must stay last: the thread starts running in the constructor.
+  std::thread thread;
+};
+
+#ifdef BASIC_LOG_HAVE_ZLIB
+/**
+ * * @brief Compress from into to with gzip and remove from on success.
+ */
+inline bool GzipFile(const std::string& from, const std::string& to) {
+  int in = ::open(from.c_str(), O_RDONLY | O_CLOEXEC);
+  if (in < 0) {
+    return false;
+  }
+  std::string partial = to + ".tmp";
+  gzFile out = gzopen(partial.c_str(), "wb");
+  bool ok = out != nullptr;
+  char chunk[64 * 1024];
+  while (ok) {
+    ssize_t n = ::read(in, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      ok = n == 0;
+      break;
+    }
+    ok = gzwrite(out, chunk, static_cast<unsigned>(n)) == n;
+  }
+  ::close(in);
+  if (out != nullptr && gzclose(out) != Z_OK) {
+    ok = false;
+  }
+  if (ok && std::rename(partial.c_str(), to.c_str()) == 0) {
+    std::remove(from.c_str());
+    return true;
+  }
+  std::remove(partial.c_str());
+  return false;
+}
+#endif
+
+}  // namespace detail
+}  // namespace basic_log
+
+/**
+ * * @brief Destination of finished records.
+ * * @details Sinks are registered through Options::sinks. Unless a sink
+ * declares itself ThreadSafe, the logger never calls it from two threads at
+ * once: in the synchronous mode calls are serialized by a per-sink mutex, in
+ * the asynchronous mode they come from the writer thread, which passes whole
+ * batches at a time.
+ */
+class Logging::Sink {
+ public:
+  virtual ~Sink() = default;
+
+  /**
+   * * @brief Write a batch of records.
+   * * @details Each record's text is a complete line including the trailing
+   * newline. The views are only valid during the call.
+   */
+  virtual void Write(const Record* records, size_t count) = 0;
+
+  /**
+   * * @brief Push anything the sink buffers to its destination.
+   */
+  virtual void Flush() {}
+
+  /**
+   * * @brief How often the logger should call Flush; zero for never.
+   */
+  virtual std::chrono::milliseconds FlushInterval() const {
+    return std::chrono::milliseconds::zero();
+  }
+
+  /**
+   * * @brief Whether Write and Flush may run on several threads at once.
+   * * @details Thread-safe sinks are called without the per-sink mutex and,
+   * in the asynchronous mode too, directly from the thread that logs, with
+   * the record still in that thread's buffer.
+   */
+  virtual bool ThreadSafe() const { return false; }
+
+  /**
+   * * @brief Write out what the sink still holds in memory, from a crash
+   * signal handler; see InstallCrashHandlers.
+   * * @details Only async-signal-safe calls such as write(2) may be used.
+   * Nothing is locked, so another thread may be inside Write at the time.
+   */
+  virtual void EmergencyFlush() {}
+
+  /**
+   * * @brief Write a record that was still queued for the writer thread, from
+   * a crash signal handler; see EmergencyFlush. Called after it.
+   * * @details The default writes the record to standard error.
+   */
+  virtual void EmergencyWrite(const Record& record) {
+    basic_log::detail::WriteFully(STDERR_FILENO, record.text);
+  }
+
+ private:
+  friend class Logging;
+  /// @brief Serializes the calls into a sink that is not ThreadSafe.
+  std::mutex mutex;
+};
+
+/**
+ * * @brief Writes to standard error, the default sink.
+ * * @details Every batch goes out in a single writev(2) straight from the
+ * records, without going through std::cerr. With a flush_interval, records
+ * are held back instead until buffer_size bytes have accumulated, until the
+ * oldest of them has waited flush_interval or until a record at or above
+ * flush_level arrives, which cuts the number of writes when standard error
+ * is a pipe. By default nothing is held back.
+ * * @note Held-back records are not ordered with what the program writes to
+ * std::cerr itself in the meantime.
+ */
+class Logging::ConsoleSink : public Sink {
+ public:
+  struct Options {
+    /// @brief Descriptor to write to.
+    int fd{STDERR_FILENO};
+    /// @brief Longest a record is held back; 0 writes every batch at once.
+    std::chrono::milliseconds flush_interval{0};
+    size_t buffer_size{16 * 1024};
+    LogLevel flush_level{WARN};
+  };
+
+  ConsoleSink() : ConsoleSink(Options()) {}
+
+  explicit ConsoleSink(const Options& options)
+      : options(options),
+        buffer(options.flush_interval > std::chrono::milliseconds::zero()
+                   ? new char[options.buffer_size]
+                   : nullptr) {}
+
+  ~ConsoleSink() override { Flush(); }
+
+  ConsoleSink(const ConsoleSink&) = delete;
+  ConsoleSink& operator=(const ConsoleSink&) = delete;
+
+  void Write(const Record* records, size_t count) override {
+    bool urgent = buffer == nullptr;
+    size_t bytes = used;
+    for (size_t i = 0; i < count; ++i) {
+      urgent = urgent || records[i].level >= options.flush_level;
+      bytes += records[i].text.size();
+    }
+    if (!urgent && bytes <= options.buffer_size) {
+      if (used == 0) {
+        held_since = std::chrono::steady_clock::now();
+      }
+      for (size_t i = 0; i < count; ++i) {
+        std::memcpy(buffer.get() + used, records[i].text.data(),
+                    records[i].text.size());
+        used += records[i].text.size();
+      }
+      if (std::chrono::steady_clock::now() - held_since <
+          options.flush_interval) {
+        return;
+      }
+      count = 0;
+    }
+    // What is held back and the batch, in one write.
+    iov.clear();
+    if (used > 0) {
+      iov.push_back({buffer.get(), used});
+    }
+    for (size_t i = 0; i < count; ++i) {
+      iov.push_back({const_cast<char*>(records[i].text.data()),
+                     records[i].text.size()});
+    }
+    // Nobody to report a failed write to; the data is dropped.
+    basic_log::detail::WriteFully(options.fd, iov.data(), iov.size());
+    used = 0;
+  }
+
+  void Flush() override {
+    if (used > 0) {
+      basic_log::detail::WriteFully(options.fd, {buffer.get(), used});
+      used = 0;
+    }
+  }
+
+  std::chrono::milliseconds FlushInterval() const override {
+    return options.flush_interval;
+  }
+
+  void EmergencyFlush() override { Flush(); }
+
+  void EmergencyWrite(const Record& record) override {
+    basic_log::detail::WriteFully(options.fd, record.text);
+  }
+
+ private:
+  const Options options;
+  std::unique_ptr<char[]> buffer;
+  size_t used{0};
+  /// @brief When the oldest held-back record arrived.
+  std::chrono::steady_clock::time_point held_since;
+  std::vector<iovec> iov;
+};
+
+/**
+ * * @brief Appends records to a file in large coalesced blocks.
+ * * @details Records are collected in a buffer of options.buffer_size bytes
+ * and written with a single write(2) when it fills up, when the flush interval
+ * has elapsed or right away for records at or above options.flush_level. A
+ * record that does not fit in the buffer at all is written together with the
+ * buffered data in one writev(2), without being copied.
+ *
+ * The file is rotated before a write would grow it beyond max_file_size and
+ * once rotation_interval has passed since it was opened: it is renamed to
+ * "<path>.<YYYYmmdd-HHMMSS>" and a new file is opened at path. Rotation
+ * happens on whichever thread writes to the sink, which is the writer thread
+ * in the asynchronous mode, so producers never wait for it. Compressing the
+ * rotated segment and deleting segments beyond max_files is left to a
+ * background thread.
+ */
+class Logging::FileSink : public Sink {
+ public:
+  struct Options {
+    size_t buffer_size{64 * 1024};
+    std::chrono::milliseconds flush_interval{1000};
+    LogLevel flush_level{ERROR};
+    /// @brief Rotate before the file exceeds this many bytes; 0 for never.
+    size_t max_file_size{0};
+    /// @brief Rotate once the file is this old; 0 for never.
+    std::chrono::seconds rotation_interval{0};
+    /// @brief Rotated segments to keep; 0 keeps all of them.
+    size_t max_files{0};
+    /// @brief gzip rotated segments. Requires zlib (BASIC_LOG_HAVE_ZLIB).
+    bool compress{false};
+  };
+
+  /**
+   * * @brief Open path for appending, creating it if needed.
+   * * @throws std::system_error if the file cannot be opened.
+   */
+  explicit FileSink(std::string path) : FileSink(std::move(path), Options()) {}
+
+  /**
+   * * @throws std::system_error if the file cannot be opened.
+   * * @throws std::invalid_argument if compression is requested without zlib.
+   */
+  FileSink(std::string path, const Options& options)
+      : path(std::move(path)),
+        options(options),
+        buffer(new char[options.buffer_size]),
+        last_flush(std::chrono::steady_clock::now()) {
+#ifndef BASIC_LOG_HAVE_ZLIB
+    if (options.compress) {
+      throw std::invalid_argument("basic_log was built without zlib");
+    }
+#endif
+    if (!Open()) {
+      throw std::system_error(errno, std::generic_category(),
+                              "cannot open log file " + this->path);
+    }
+  }
+
+  ~FileSink() override {
+    Flush();
+    ::close(fd);
+    // Finishes pending compression before the sink goes away.
+    archiver.reset();
+  }
+
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+
+  void Write(const Record* records, size_t count) override {
+    bool urgent = false;
+    for (size_t i = 0; i < count; ++i) {
+      std::string_view text = records[i].text;
+      urgent = urgent || records[i].level >= options.flush_level;
+      if (used + text.size() <= options.buffer_size) {
+        std::memcpy(buffer.get() + used, text.data(), text.size());
+        used += text.size();
+        continue;
+      }
+      if (text.size() < options.buffer_size) {
+        Flush();
+        std::memcpy(buffer.get(), text.data(), text.size());
+        used = text.size();
+        continue;
+      }
+      iovec iov[2] = {{buffer.get(), used},
+                      {const_cast<char*>(text.data()), text.size()}};
+      WriteOut(iov, 2, used + text.size());
+      used = 0;
+      last_flush = std::chrono::steady_clock::now();
+    }
+    if (urgent ||
+        std::chrono::steady_clock::now() - last_flush >=
+            options.flush_interval) {
+      Flush();
+    }
+  }
+
+  void Flush() override {
+    if (used > 0) {
+      iovec iov{buffer.get(), used};
+      WriteOut(&iov, 1, used);
+      used = 0;
+    }
+    last_flush = std::chrono::steady_clock::now();
+  }
+
+  std::chrono::milliseconds FlushInterval() const override {
+    return options.flush_interval;
+  }
+
+  void EmergencyFlush() override {
+    if (used > 0 && fd >= 0) {
+      basic_log::detail::WriteFully(fd, {buffer.get(), used});
+      used = 0;
+    }
+  }
+
+  void EmergencyWrite(const Record& record) override {
+    if (fd >= 0) {
+      basic_log::detail::WriteFully(fd, record.text);
+    }
+  }
+
+  const std::string& Path() const { return path; }
+
+ private:
+  bool Open() {
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat info {};
+    file_size = ::fstat(fd, &info) == 0 ? static_cast<size_t>(info.st_size) : 0;
+    opened = std::chrono::steady_clock::now();
+    return true;
+  }
+
+  void WriteOut(iovec* iov, size_t count, size_t bytes) {
+    bool too_big = options.max_file_size > 0 && file_size > 0 &&
+                   file_size + bytes > options.max_file_size;
+    bool too_old =
+        options.rotation_interval > std::chrono::seconds::zero() &&
+        std::chrono::steady_clock::now() - opened >= options.rotation_interval;
+    if (too_big || too_old) {
+      Rotate();
+    }
+    // Nobody to report a failed write to; the data is dropped.
+    if (fd >= 0 && basic_log::detail::WriteFully(fd, iov, count)) {
+      file_size += bytes;
+    }
+  }
+
+  void Rotate() {
+    std::string rotated = RotatedName();
+    ::close(fd);
+    fd = -1;
+    if (std::rename(path.c_str(), rotated.c_str()) != 0) {
+      rotated.clear();
+    }
+    if (!Open()) {
+      return;
+    }
+    if (rotated.empty() || (!options.compress && options.max_files == 0)) {
+      return;
+    }
+    if (!archiver) {
+      archiver = std::make_unique<basic_log::detail::TaskThread>();
+    }
+    archiver->Post([this, rotated] { Archive(rotated); });
+  }
+
+  std::string RotatedName() const {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_r(&now, &local);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    std::string base = path + "." + stamp;
+    std::string name = base;
+    for (int i = 1; Exists(name) || Exists(name + ".gz"); ++i) {
+      name = base + "." + std::to_string(i);
+    }
+    return name;
+  }
+
+  static bool Exists(const std::string& name) {
+    struct stat info {};
+    return ::stat(name.c_str(), &info) == 0;
+  }
+
+  /// @brief Runs on the archiver thread.
+  void Archive([[maybe_unused]] const std::string& rotated) {
+#ifdef BASIC_LOG_HAVE_ZLIB
+    if (options.compress) {
+      basic_log::detail::GzipFile(rotated, rotated + ".gz");
+    }
+#endif
+    if (options.max_files > 0) {
+      RemoveOldSegments();
+    }
+  }
+
+  void RemoveOldSegments() {
+    namespace fs = std::filesystem;
+    fs::path active(path);
+    fs::path dir = active.has_parent_path() ? active.parent_path() : ".";
+    std::string prefix = active.filename().string() + ".";
+    std::vector<fs::path> segments;
+    std::error_code ec;
+    // increment(ec), not ++: this runs on the archiver thread, where an
+    // exception would terminate the process.
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+      std::string name = it->path().filename().string();
+      if (name.compare(0, prefix.size(), prefix) == 0 &&
+          name.size() > prefix.size() &&
+          (name.size() < 4 || name.compare(name.size() - 4, 4, ".tmp") != 0)) {
+        segments.push_back(it->path());
+      }
+    }
+    // A partial listing could pick the wrong segments as the oldest.
+    if (ec || segments.size() <= options.max_files) {
+      return;
+    }
+    // Oldest first. Segments are written and compressed in rotation order,
+    // so their modification times are ordered too.
+    std::sort(segments.begin(), segments.end(),
+              [](const fs::path& a, const fs::path& b) {
+                std::error_code ignored;
+                auto ta = fs::last_write_time(a, ignored);
+                auto tb = fs::last_write_time(b, ignored);
+                return ta != tb ? ta < tb : a < b;
+              });
+    for (size_t i = 0; i + options.max_files < segments.size(); ++i) {
+      fs::remove(segments[i], ec);
+    }
+  }
+
+  const std::string path;
+  const Options options;
+  int fd{-1};
+  size_t file_size{0};
+  std::chrono::steady_clock::time_point opened;
+  std::unique_ptr<char[]> buffer;
+  size_t used{0};
+  std::chrono::steady_clock::time_point last_flush;
+  std::unique_ptr<basic_log::detail::TaskThread> archiver;
+};
+
+#endif  // BASIC_LOG_SINK_H
@@ -0,0 +1,632 @@
+// Multi-threaded stress test of the logging backends.
+//
+// Usage: BasicLogStress [--threads=N] [--records=N] [--backends=LIST]
+//                       [--mix=text|containers|chrono|mixed] [--max-size=N]
+//                       [--policy=block|drop-newest|drop-oldest] [--keep]
+//
+// Every producer thread logs --records records through each backend in
+// LIST, a comma-separated selection of sync, async, async-queues, mmap and
+// network (default: all of them). The report shows the throughput up to the
+// end of Logging::Flush, the latency of the LOG statements, and what reading
+// the output back found: records lost, records dropped by the overflow
+// policies, and records that were duplicated, torn apart, interleaved with
+// others or reordered within their thread. The exit status is 1 if any
+// record is corrupt, duplicated or reordered, or was lost without being
+// counted as dropped.
+//
+// The network backend sends syslog over TCP to a collector on the loopback
+// interface. Output goes to a temporary directory that --keep preserves.
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "basic_log.h"
+#include "basic_log_mmap_sink.h"
+#include "basic_log_network_sink.h"
+#include "basic_log_sink.h"
+
+namespace {
+
+/**
+ * * @brief Latencies in nanoseconds, in log-linear buckets like
+ * HdrHistogram.
+ * * @details Values below kSubBuckets are counted exactly; above, each power
+ * of two is split into kSubBuckets buckets, so a value is known to within
+ * 1/kSubBuckets of itself.
+ */
+class Histogram {
+ public:
+  static constexpr int kSubBits = 7;
+  static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBits;
+
+  Histogram() : counts((64 - kSubBits + 1) * kSubBuckets) {}
+
+  void Record(uint64_t value) {
+    ++counts[Index(value)];
+    ++total;
+    max = std::max(max, value);
+  }
+
+  void Add(const Histogram& other) {
+    for (size_t i = 0; i < counts.size(); ++i) {
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+    max = std::max(max, other.max);
+  }
+
+  /// @return The highest value of the bucket the quantile falls into.
+  uint64_t Quantile(double quantile) const {
+    auto rank = static_cast<uint64_t>(quantile * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+      seen += counts[i];
+      if (seen > rank) {
+        return std::min(Highest(i), max);
+      }
+    }
+    return max;
+  }
+
+  uint64_t Max() const { return max; }
+
+ private:
+  static size_t Index(uint64_t value) {
+    if (value < kSubBuckets) {
+      return static_cast<size_t>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - kSubBits;
+    return static_cast<size_t>((static_cast<uint64_t>(shift) + 1) *
+                                   kSubBuckets +
+                               ((value >> shift) - kSubBuckets));
+  }
+
+  static uint64_t Highest(size_t index) {
+    if (index < kSubBuckets) {
+      return index;
+    }
+    uint64_t shift = index / kSubBuckets - 1;
+    uint64_t lowest = (kSubBuckets + index % kSubBuckets) << shift;
+    return lowest + ((uint64_t{1} << shift) - 1);
+  }
+
+  std::vector<uint64_t> counts;
+  uint64_t total{0};
+  uint64_t max{0};
+};
+
+enum class Mix { TEXT, CONTAINERS, CHRONO, MIXED };
+
+struct Settings {
+  int threads{4};
+  uint64_t records{100000};
+  std::vector<std::string> backends{"sync", "async", "async-queues", "mmap",
+                                    "network"};
+  Mix mix{Mix::MIXED};
+  /// @brief Longest filler string of a record.
+  size_t max_size{64};
+  Logging::OverflowPolicy policy{Logging::OverflowPolicy::BLOCK};
+  bool keep{false};
+};
+
+/// @brief The values of src/main.cpp, made once per thread.
+struct Payload {
+  std::vector<int> vector{1, 2, 3, 4, 5};
+  std::map<std::string, int> map{{"key1", 1}, {"key2", 2}};
+  std::set<int> set{1, 2, 3};
+  std::unordered_map<std::string, int> unordered_map{{"key1", 1}};
+  std::optional<int> optional{42};
+  std::optional<std::string> optional_string{"Hello, World!"};
+};
+
+/**
+ * * @brief Log record n of thread.
+ * * @details Every record starts with "stress THREAD N SIZE FILLER", where
+ * FILLER is SIZE times the same letter, and ends with "end"; Verify relies
+ * on it.
+ */
+void LogRecord(int thread, uint64_t n, Mix mix, const std::string& filler,
+               const Payload& payload) {
+  if (mix == Mix::MIXED) {
+    mix = static_cast<Mix>(n % 3);
+  }
+  switch (mix) {
+    case Mix::TEXT:
+      LOG(INFO) << "stress" << thread << n << filler.size() << filler
+                << "This is an info" << 11 << "message" << 3.14555 << false
+                << "end";
+      break;
+    case Mix::CONTAINERS:
+      LOG(INFO) << "stress" << thread << n << filler.size() << filler
+                << payload.vector << std::make_pair(1, 2) << payload.map
+                << payload.set << payload.unordered_map << payload.optional
+                << payload.optional_string << std::optional<int>{} << "end";
+      break;
+    case Mix::CHRONO:
+    case Mix::MIXED:
+      LOG(INFO) << "stress" << thread << n << filler.size() << filler
+                << std::chrono::seconds(1) << std::chrono::milliseconds(1000)
+                << std::chrono::microseconds(1000)
+                << std::chrono::nanoseconds(1000) << std::chrono::hours(1)
+                << std::chrono::minutes(1)
+                << std::chrono::system_clock::now() << "end";
+      break;
+  }
+}
+
+char FillerLetter(int thread, uint64_t n) {
+  return static_cast<char>('a' + (static_cast<uint64_t>(thread) + n) % 26);
+}
+
+/// @brief What reading the output back found.
+struct Check {
+  uint64_t found{0};
+  uint64_t duplicated{0};
+  uint64_t corrupt{0};
+  uint64_t reordered{0};
+};
+
+bool ParseNumber(std::string_view text, uint64_t& value) {
+  if (text.empty() || text.size() > 19) {
+    return false;
+  }
+  value = 0;
+  for (char c : text) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    value = value * 10 + static_cast<uint64_t>(c - '0');
+  }
+  return true;
+}
+
+std::string_view NextToken(std::string_view& text) {
+  size_t end = text.find(' ');
+  std::string_view token = text.substr(0, end);
+  text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+  return token;
+}
+
+/// @brief Check every record of lines and which of the expected ones exist.
+Check Verify(const std::vector<std::string_view>& lines,
+             const Settings& settings) {
+  Check check;
+  std::vector<uint8_t> seen(static_cast<size_t>(settings.threads) *
+                            settings.records);
+  std::vector<int64_t> last(static_cast<size_t>(settings.threads), -1);
+  constexpr std::string_view kPrefix = "[INFO][";
+  constexpr std::string_view kStart = "]: stress ";
+  constexpr std::string_view kEnd = " end";
+  for (std::string_view line : lines) {
+    size_t start = line.find(kStart);
+    if (line.substr(0, kPrefix.size()) != kPrefix ||
+        start == std::string_view::npos || line.size() < kEnd.size() ||
+        line.substr(line.size() - kEnd.size()) != kEnd) {
+      ++check.corrupt;
+      continue;
+    }
+    std::string_view rest = line.substr(start + kStart.size());
+    uint64_t thread;
+    uint64_t n;
+    uint64_t size;
+    if (!ParseNumber(NextToken(rest), thread) ||
+        !ParseNumber(NextToken(rest), n) ||
+        !ParseNumber(NextToken(rest), size) ||
+        thread >= static_cast<uint64_t>(settings.threads) ||
+        n >= settings.records) {
+      ++check.corrupt;
+      continue;
+    }
+    std::string_view filler = NextToken(rest);
+    char letter = FillerLetter(static_cast<int>(thread), n);
+    if (filler.size() != size ||
+        std::any_of(filler.begin(), filler.end(),
+                    [letter](char c) { return c != letter; })) {
+      ++check.corrupt;
+      continue;
+    }
+    uint8_t& mark = seen[thread * settings.records + n];
+    if (mark != 0) {
+      ++check.duplicated;
+      continue;
+    }
+    mark = 1;
+    ++check.found;
+    if (static_cast<int64_t>(n) < last[thread]) {
+      ++check.reordered;
+    }
+    last[thread] = static_cast<int64_t>(n);
+  }
+  return check;
+}
+
+std::vector<std::string_view> SplitLines(std::string_view text) {
+  std::vector<std::string_view> lines;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    if (!line.empty()) {
+      lines.push_back(line);
+    }
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+  }
+  return lines;
+}
+
+/**
+ * * @brief The records of RFC 6587 octet-counted syslog frames: the text
+ * from the record's prefix on. A frame without one is kept whole, so that
+ * Verify counts it as corrupt.
+ */
+std::vector<std::string_view> SplitFrames(std::string_view stream) {
+  std::vector<std::string_view> lines;
+  while (!stream.empty()) {
+    size_t space = stream.find(' ');
+    uint64_t size;
+    if (space == std::string_view::npos ||
+        !ParseNumber(stream.substr(0, space), size) ||
+        size > stream.size() - space - 1) {
+      lines.push_back(stream);
+      break;
+    }
+    std::string_view message = stream.substr(space + 1, size);
+    stream.remove_prefix(space + 1 + size);
+    size_t record = message.find("[INFO][");
+    if (record != std::string_view::npos) {
+      message.remove_prefix(record);
+    }
+    while (!message.empty() && message.back() == '\n') {
+      message.remove_suffix(1);
+    }
+    lines.push_back(message);
+  }
+  return lines;
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return {std::istreambuf_iterator<char>(file),
+          std::istreambuf_iterator<char>()};
+}
+
+/// @brief Accepts TCP connections on the loopback interface and keeps all
+/// bytes received.
+class Collector {
+ public:
+  Collector() {
+    listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    if (listener < 0 ||
+        ::bind(listener, reinterpret_cast<sockaddr*>(&address), length) != 0 ||
+        ::listen(listener, 16) != 0 ||
+        ::getsockname(listener, reinterpret_cast<sockaddr*>(&address),
+                      &length) != 0) {
+      std::perror("BasicLogStress: collector");
+      std::exit(2);
+    }
+    port = ntohs(address.sin_port);
+    thread = std::thread([this] { Run(); });
+  }
+
+  ~Collector() {
+    if (thread.joinable()) {
+      Stop();
+    }
+  }
+
+  uint16_t Port() const { return port; }
+
+  /// @brief Wait until every connection is closed, for at most 10 s.
+  std::string Stop() {
+    stopping.store(true, std::memory_order_relaxed);
+    thread.join();
+    ::close(listener);
+    return std::move(received);
+  }
+
+ private:
+  void Run() {
+    std::vector<pollfd> fds{{listener, POLLIN, 0}};
+    std::chrono::steady_clock::time_point deadline{};
+    char chunk[64 * 1024];
+    for (;;) {
+      if (stopping.load(std::memory_order_relaxed)) {
+        auto now = std::chrono::steady_clock::now();
+        if (deadline == std::chrono::steady_clock::time_point{}) {
+          deadline = now + std::chrono::seconds(10);
+        }
+        if (fds.size() == 1 || now >= deadline) {
+          break;
+        }
+      }
+      if (::poll(fds.data(), fds.size(), 50) <= 0) {
+        continue;
+      }
+      if (fds[0].revents & POLLIN) {
+        int client = ::accept(listener, nullptr, nullptr);
+        if (client >= 0) {
+          fds.push_back({client, POLLIN, 0});
+        }
+      }
+      for (size_t i = 1; i < fds.size();) {
+        if (fds[i].revents == 0) {
+          ++i;
+          continue;
+        }
+        ssize_t size = ::recv(fds[i].fd, chunk, sizeof(chunk), 0);
+        if (size > 0) {
+          received.append(chunk, static_cast<size_t>(size));
+          ++i;
+        } else {
+          ::close(fds[i].fd);
+          fds.erase(fds.begin() + static_cast<ptrdiff_t>(i));
+        }
+      }
+    }
+    for (size_t i = 1; i < fds.size(); ++i) {
+      ::close(fds[i].fd);
+    }
+  }
+
+  int listener{-1};
+  uint16_t port{0};
+  std::atomic<bool> stopping{false};
+  std::string received;
+  std::thread thread;
+};
+
+uint64_t DroppedRecords() {
+  Logging::Stats stats = Logging::GetStats();
+  uint64_t dropped = 0;
+  for (uint64_t count : stats.dropped) {
+    dropped += count;
+  }
+  return dropped;
+}
+
+/// @brief Stop logging to the backend, so that its sinks finish their work.
+void Release() {
+  Logging::Options options;
+  options.level = Logging::WARN;
+  Logging::BasicConfig(options);
+}
+
+/// @return false if the backend lost or damaged records.
+bool Run(const std::string& backend, const Settings& settings) {
+  namespace fs = std::filesystem;
+  fs::path directory =
+      fs::temp_directory_path() /
+      ("basic_log_stress." + std::to_string(::getpid()) + "." + backend);
+  fs::remove_all(directory);
+  fs::create_directories(directory);
+  fs::path path = directory / "stress.log";
+
+  Logging::Options options;
+  options.level = Logging::INFO;
+  options.async.overflow_policy = settings.policy;
+  std::shared_ptr<Logging::NetworkSink> network;
+  std::optional<Collector> collector;
+  if (backend == "sync" || backend == "async" || backend == "async-queues") {
+    options.async.enabled = backend != "sync";
+    options.async.per_thread_queues = backend == "async-queues";
+    options.sinks.push_back(std::make_shared<Logging::FileSink>(path.string()));
+  } else if (backend == "mmap") {
+    options.sinks.push_back(std::make_shared<Logging::MmapSink>(path.string()));
+  } else if (backend == "network") {
+    collector.emplace();
+    Logging::NetworkSink::Options network_options;
+    network_options.max_queued = size_t{256} * 1024 * 1024;
+    network_options.linger = std::chrono::seconds(10);
+    network = std::make_shared<Logging::NetworkSink>(
+        Logging::NetworkSink::Protocol::SYSLOG_TCP, "127.0.0.1",
+        collector->Port(), network_options);
+    options.sinks.push_back(network);
+  } else {
+    std::fprintf(stderr, "BasicLogStress: unknown backend %s\n",
+                 backend.c_str());
+    return false;
+  }
+  Logging::BasicConfig(options);
+  options.sinks.clear();
+
+  uint64_t dropped_before = DroppedRecords();
+  std::vector<Histogram> histograms(static_cast<size_t>(settings.threads));
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> producers;
+  for (int t = 0; t < settings.threads; ++t) {
+    producers.emplace_back([&, t] {
+      Payload payload;
+      std::string filler;
+      Histogram& histogram = histograms[static_cast<size_t>(t)];
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      for (uint64_t n = 0; n < settings.records; ++n) {
+        filler.assign(1 + (n * 7919 + static_cast<uint64_t>(t)) %
+                              settings.max_size,
+                      FillerLetter(t, n));
+        auto start = std::chrono::steady_clock::now();
+        LogRecord(t, n, settings.mix, filler, payload);
+        auto end = std::chrono::steady_clock::now();
+        histogram.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                .count()));
+      }
+    });
+  }
+  while (ready.load() != settings.threads) {
+    std::this_thread::yield();
+  }
+  auto start = std::chrono::steady_clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  Logging::Flush();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  uint64_t dropped = DroppedRecords() - dropped_before;
+  if (network) {
+    dropped += network->DroppedCount();
+    network.reset();
+  }
+  Release();
+
+  std::string output;
+  std::vector<std::string_view> lines;
+  if (collector) {
+    output = collector->Stop();
+    lines = SplitFrames(output);
+  } else {
+    // Segments of the mmap sink sort by their zero-padded sequence number.
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+      files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+      output += ReadFile(file);
+    }
+    // The unused tail of a segment that was not truncated.
+    output.erase(std::remove(output.begin(), output.end(), '\0'),
+                 output.end());
+    lines = SplitLines(output);
+  }
+  Check check = Verify(lines, settings);
+
+  Histogram latency;
+  for (const auto& histogram : histograms) {
+    latency.Add(histogram);
+  }
+  uint64_t expected = static_cast<uint64_t>(settings.threads) *
+                      settings.records;
+  uint64_t lost = expected - check.found;
+  std::printf(
+      "%-13s %8.3f %8lu %8lu %8lu %9lu %10lu %8lu %8lu %8lu %8lu %9lu\n",
+      backend.c_str(), static_cast<double>(expected) / seconds / 1e6,
+      static_cast<unsigned long>(latency.Quantile(0.5)),
+      static_cast<unsigned long>(latency.Quantile(0.99)),
+      static_cast<unsigned long>(latency.Quantile(0.999)),
+      static_cast<unsigned long>(latency.Max()),
+      static_cast<unsigned long>(lost), static_cast<unsigned long>(dropped),
+      static_cast<unsigned long>(check.corrupt),
+      static_cast<unsigned long>(check.duplicated),
+      static_cast<unsigned long>(check.reordered),
+      static_cast<unsigned long>(output.size() >> 10));
+  std::fflush(stdout);
+  if (!settings.keep) {
+    fs::remove_all(directory);
+  }
+  return check.corrupt == 0 && check.duplicated == 0 &&
+         check.reordered == 0 && lost <= dropped;
+}
+
+std::vector<std::string> SplitList(std::string_view list) {
+  std::vector<std::string> items;
+  while (!list.empty()) {
+    size_t end = list.find(',');
+    items.emplace_back(list.substr(0, end));
+    list.remove_prefix(end == std::string_view::npos ? list.size() : end + 1);
+  }
+  return items;
+}
+
+/// @return false if argument is not a valid option.
+bool ParseOption(std::string_view argument, Settings& settings) {
+  size_t equals = argument.find('=');
+  std::string_view name = argument.substr(0, equals);
+  std::string_view value =
+      equals == std::string_view::npos ? "" : argument.substr(equals + 1);
+  uint64_t number = 0;
+  if (name == "--keep" && equals == std::string_view::npos) {
+    settings.keep = true;
+  } else if (name == "--threads" && ParseNumber(value, number) && number > 0 &&
+             number <= 1024) {
+    settings.threads = static_cast<int>(number);
+  } else if (name == "--records" && ParseNumber(value, number) && number > 0) {
+    settings.records = number;
+  } else if (name == "--max-size" && ParseNumber(value, number) &&
+             number > 0) {
+    settings.max_size = number;
+  } else if (name == "--backends" && !value.empty()) {
+    settings.backends = SplitList(value);
+  } else if (name == "--mix") {
+    static const std::pair<std::string_view, Mix> kMixes[] = {
+        {"text", Mix::TEXT},
+        {"containers", Mix::CONTAINERS},
+        {"chrono", Mix::CHRONO},
+        {"mixed", Mix::MIXED}};
+    auto it = std::find_if(
+        std::begin(kMixes), std::end(kMixes),
+        [value](const auto& mix) { return mix.first == value; });
+    if (it == std::end(kMixes)) {
+      return false;
+    }
+    settings.mix = it->second;
+  } else if (name == "--policy") {
+    if (value == "block") {
+      settings.policy = Logging::OverflowPolicy::BLOCK;
+    } else if (value == "drop-newest") {
+      settings.policy = Logging::OverflowPolicy::DROP_NEWEST;
+    } else if (value == "drop-oldest") {
+      settings.policy = Logging::OverflowPolicy::DROP_OLDEST;
+    } else {
+      return false;
+    }
+  } else {
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  Settings settings;
+  for (int i = 1; i < argc; ++i) {
+    if (!ParseOption(argv[i], settings)) {
+      std::fprintf(stderr, "BasicLogStress: invalid argument %s\n", argv[i]);
+      return 2;
+    }
+  }
+  std::printf("%d threads x %lu records\n", settings.threads,
+              static_cast<unsigned long>(settings.records));
+  std::printf("%-13s %8s %8s %8s %8s %9s %10s %8s %8s %8s %8s %9s\n",
+              "backend", "Mrec/s", "p50 ns", "p99 ns", "p99.9 ns", "max ns",
+              "lost", "dropped", "corrupt", "dup", "reorder", "KiB");
+  bool passed = true;
+  for (const auto& backend : settings.backends) {
+    passed = Run(backend, settings) && passed;
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,213 @@
+#ifndef BASIC_LOG_STRUCTURED_H
+#define BASIC_LOG_STRUCTURED_H
+
+// Helpers of the JSON and logfmt record formats. A record of either format
+// carries the prefix fields, the fields attached with Logging::With and the
+// streamed values as one "msg" string.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "basic_log_buffer.h"
+
+namespace basic_log {
+namespace detail {
+
+/// @brief Whether c has to be escaped inside a JSON or quoted logfmt string.
+constexpr bool NeedsEscape(char c) {
+  return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+}
+
+/// @brief The escaped form of c, a NeedsEscape character, into out.
+/// @return The length written, at most 6.
+inline size_t EscapeChar(char c, char* out) {
+  out[0] = '\\';
+  switch (c) {
+    case '"':
+    case '\\':
+      out[1] = c;
+      return 2;
+    case '\n':
+      out[1] = 'n';
+      return 2;
+    case '\r':
+      out[1] = 'r';
+      return 2;
+    case '\t':
+      out[1] = 't';
+      return 2;
+    default: {
+      constexpr char kHex[] = "0123456789abcdef";
+      auto byte = static_cast<unsigned char>(c);
+      std::memcpy(out + 1, "u00", 3);
+      out[4] = kHex[byte >> 4];
+      out[5] = kHex[byte & 0xf];
+      return 6;
+    }
+  }
+}
+
+/// @brief Append text, escaped for a JSON or quoted logfmt string.
+inline void AppendEscaped(LogBuffer& buffer, std::string_view text) {
+  size_t plain = 0;
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (!NeedsEscape(text[i])) {
+      continue;
+    }
+    buffer.Append(text.data() + plain, i - plain);
+    buffer.Commit(EscapeChar(text[i], buffer.Reserve(6)));
+    plain = i + 1;
+  }
+  buffer.Append(text.data() + plain, text.size() - plain);
+}
+
+/**
+ * * @brief Escape the bytes appended to buffer since start, in place.
+ * * @details Values are formatted straight into the record and only rewritten
+ * in the rare case that they contain something to escape.
+ */
+inline void EscapeFrom(LogBuffer& buffer, size_t start) {
+  size_t end = buffer.size();
+  size_t first = start;
+  while (first < end && !NeedsEscape(buffer.data()[first])) {
+    ++first;
+  }
+  if (first == end) {
+    return;
+  }
+  std::string tail(buffer.data() + first, end - first);
+  buffer.Truncate(first);
+  AppendEscaped(buffer, tail);
+}
+
+/// @brief Whether text can be a logfmt value without quotes.
+constexpr bool IsBareValue(std::string_view text) {
+  if (text.empty()) {
+    return false;
+  }
+  for (char c : text) {
+    if (c == ' ' || c == '=' || NeedsEscape(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// @brief Append text as a logfmt value, quoted and escaped if it must be.
+inline void AppendLogfmtValue(LogBuffer& buffer, std::string_view text) {
+  if (IsBareValue(text)) {
+    buffer.Append(text);
+    return;
+  }
+  buffer.Append('"');
+  AppendEscaped(buffer, text);
+  buffer.Append('"');
+}
+
+/// @brief Append name as a logfmt key; what a key cannot contain becomes '_'.
+inline void AppendLogfmtKey(LogBuffer& buffer, std::string_view name) {
+  if (name.empty()) {
+    buffer.Append('_');
+  }
+  for (char c : name) {
+    buffer.Append(c == ' ' || c == '=' || NeedsEscape(c) ? '_' : c);
+  }
+}
+
+/**
+ * * @brief The key of a field attached with Logging::With.
+ * * @details Whether the key can be copied as is is worked out when the key
+ * is constructed. For a literal or a constexpr key that is at compile time,
+ * so only unusual keys are escaped per record: JSON escapes them, logfmt
+ * replaces what a key cannot contain with '_'.
+ */
+class FieldKey {
+ public:
+  constexpr FieldKey(const char* name) : FieldKey(std::string_view(name)) {}
+  FieldKey(const std::string& name) : FieldKey(std::string_view(name)) {}
+  constexpr FieldKey(std::string_view name)
+      : name(name), plain(IsPlain(name)) {}
+
+  const std::string_view name;
+  /// @brief Whether name only has characters both formats take as is.
+  const bool plain;
+
+ private:
+  static constexpr bool IsPlain(std::string_view name) {
+    if (name.empty()) {
+      return false;
+    }
+    for (char c : name) {
+      bool word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  (c >= '0' && c <= '9') || c == '_' || c == '.' ||
+                  c == '-' || c == '/';
+      if (!word) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * * @brief The arrays and objects a field value has open, innermost last.
+ * * @details An optional opens a transparent level, which adds no brackets.
+ */
+class FieldNesting {
+ public:
+  enum class Kind : uint8_t { NONE, ARRAY, OBJECT, TRANSPARENT };
+
+  /// @brief Deeper levels are treated as arrays.
+  static constexpr int kMaxDepth = 32;
+
+  void Open(Kind kind) {
+    if (depth < kMaxDepth) {
+      kinds |= static_cast<uint64_t>(kind) << (2 * depth);
+    }
+    ++depth;
+    if (kind != Kind::TRANSPARENT) {
+      expecting_key = kind == Kind::OBJECT;
+    }
+  }
+
+  /// @return The kind of the level closed.
+  Kind Close() {
+    if (depth == 0) {
+      return Kind::NONE;
+    }
+    Kind kind = Top();
+    --depth;
+    if (depth < kMaxDepth) {
+      kinds &= ~(uint64_t{3} << (2 * depth));
+    }
+    if (kind != Kind::TRANSPARENT) {
+      expecting_key = false;
+    }
+    return kind;
+  }
+
+  Kind Top() const {
+    if (depth == 0) {
+      return Kind::NONE;
+    }
+    if (depth > kMaxDepth) {
+      return Kind::ARRAY;
+    }
+    return static_cast<Kind>((kinds >> (2 * (depth - 1))) & 3);
+  }
+
+  /// @brief JSON keys are strings; set while an object member's key is due.
+  bool expecting_key{false};
+
+ private:
+  uint64_t kinds{0};
+  int depth{0};
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_STRUCTURED_H
@@ -0,0 +1,303 @@
+#ifndef BASIC_LOG_TIME_H
+#define BASIC_LOG_TIME_H
+
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief Where record timestamps come from; see WallClock.
+ */
+enum class ClockSource {
+  /// @brief clock_gettime(CLOCK_REALTIME), i.e. std::chrono::system_clock.
+  REALTIME,
+  /// @brief CLOCK_REALTIME_COARSE: the wall clock as of the last timer
+  /// tick, a few milliseconds old at most, for a fraction of the cost.
+  REALTIME_COARSE,
+  /// @brief The CPU's time-stamp counter, calibrated against the wall
+  /// clock; REALTIME where the counter does not tick at a constant rate.
+  TSC,
+  /// @brief std::chrono::steady_clock, offset to the wall clock when
+  /// configured. Never goes back, but does not follow wall clock changes.
+  STEADY,
+};
+
+/**
+ * * @brief The wall clock the records are stamped with.
+ * * @details With TSC a reading is the counter, converted to wall time by
+ * the last calibration. It is calibrated for 10 ms when configured and then
+ * once a second, by the first thread to find the calibration a second old.
+ * Each calibration steers the conversion towards the wall clock over the
+ * next second rather than jumping, so timestamps keep their order; only a
+ * difference of more than a second, e.g. after the wall clock was set, is
+ * taken over at once. The timestamps of a thread never go back.
+ *
+ * Only the readings are defined here; configuring and calibrating the clock
+ * is defined in basic_log_inl.h.
+ */
+class WallClock {
+ public:
+  /// @brief Not thread-safe against itself; readers may run concurrently.
+  static void Configure(ClockSource source);
+
+  static std::chrono::system_clock::time_point Now() {
+    switch (current_source.load(std::memory_order_acquire)) {
+      case ClockSource::REALTIME:
+        break;
+      case ClockSource::REALTIME_COARSE: {
+#ifdef CLOCK_REALTIME_COARSE
+        timespec now;
+        clock_gettime(CLOCK_REALTIME_COARSE, &now);
+        return FromNanos(int64_t{now.tv_sec} * 1000000000 + now.tv_nsec);
+#else
+        break;
+#endif
+      }
+      case ClockSource::TSC:
+        return FromNanos(TscNanos());
+      case ClockSource::STEADY:
+        return FromNanos(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch())
+                .count() +
+            steady_offset.load(std::memory_order_relaxed));
+    }
+    return std::chrono::system_clock::now();
+  }
+
+ private:
+  /// @brief Maps counter readings to nanoseconds since the epoch.
+  struct Calibration {
+    uint64_t ticks;
+    int64_t nanos;
+    /// @brief Nanoseconds per tick.
+    double rate;
+    /// @brief Ticks after which to calibrate again.
+    int64_t period_ticks;
+
+    int64_t Convert(uint64_t at) const {
+      // Readings from before ticks, made on another core, come out early.
+      auto delta = static_cast<int64_t>(at - ticks);
+      return nanos + static_cast<int64_t>(static_cast<double>(delta) * rate);
+    }
+  };
+
+  static std::chrono::system_clock::time_point FromNanos(int64_t nanos) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::nanoseconds(nanos)));
+  }
+
+  static int64_t RealtimeNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  /// @brief The counter's reading; meaningless unless HasCounter.
+  static uint64_t ReadCounter() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return 0;
+#endif
+  }
+
+  /// @return false if there is no counter that ticks at a constant rate.
+  static bool HasCounter();
+
+  /// @brief A reading of the counter and the wall clock at the same time.
+  static void Sample(uint64_t& ticks, int64_t& nanos) {
+    uint64_t before = ReadCounter();
+    nanos = RealtimeNanos();
+    uint64_t after = ReadCounter();
+    ticks = before + (after - before) / 2;
+  }
+
+  /// @brief Start over from a fresh measurement of the counter's rate.
+  static bool Calibrate();
+  static bool Measure();
+  /// @brief Steer the conversion towards the wall clock, see the class.
+  static void Recalibrate(const Calibration& last);
+
+  static int64_t TscNanos() {
+    uint64_t ticks = ReadCounter();
+    Calibration calibration = Load();
+    if (static_cast<int64_t>(ticks - calibration.ticks) >=
+            calibration.period_ticks &&
+        !calibrating.exchange(true, std::memory_order_acquire)) {
+      Recalibrate(calibration);
+      calibrating.store(false, std::memory_order_release);
+    }
+    // A thread that read the counter just after a calibration, but got the
+    // previous one, is a little off; its next reading must not be earlier.
+    static thread_local int64_t last = INT64_MIN;
+    last = std::max(last, calibration.Convert(ticks));
+    return last;
+  }
+
+  /// @brief Read the calibration under the seqlock.
+  static Calibration Load() {
+    for (;;) {
+      uint32_t before = sequence.load(std::memory_order_acquire);
+      Calibration calibration{
+          calibration_ticks.load(std::memory_order_relaxed),
+          calibration_nanos.load(std::memory_order_relaxed),
+          calibration_rate.load(std::memory_order_relaxed),
+          calibration_period.load(std::memory_order_relaxed)};
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((before & 1) == 0 &&
+          sequence.load(std::memory_order_relaxed) == before) {
+        return calibration;
+      }
+    }
+  }
+
+  /// @brief Replace the calibration; writers are serialized by the caller.
+  static void Publish(const Calibration& calibration) {
+    uint32_t next = sequence.load(std::memory_order_relaxed) + 1;
+    sequence.store(next, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    calibration_ticks.store(calibration.ticks, std::memory_order_relaxed);
+    calibration_nanos.store(calibration.nanos, std::memory_order_relaxed);
+    calibration_rate.store(calibration.rate, std::memory_order_relaxed);
+    calibration_period.store(calibration.period_ticks,
+                             std::memory_order_relaxed);
+    sequence.store(next + 1, std::memory_order_release);
+  }
+
+  /// @brief How often TSC is calibrated, in nanoseconds.
+  static constexpr int64_t kPeriod = 1000000000;
+
+  static inline std::atomic<ClockSource> current_source{ClockSource::REALTIME};
+  /// @brief Wall minus steady clock nanoseconds, for STEADY.
+  static inline std::atomic<int64_t> steady_offset{0};
+
+  /// @brief The first sample of Calibrate; guarded by calibrating.
+  static inline uint64_t origin_ticks{0};
+  static inline int64_t origin_nanos{0};
+  /// @brief Held by the thread that recalibrates.
+  static inline std::atomic<bool> calibrating{false};
+  /// @brief Odd while the calibration is replaced.
+  static inline std::atomic<uint32_t> sequence{0};
+  static inline std::atomic<uint64_t> calibration_ticks{0};
+  static inline std::atomic<int64_t> calibration_nanos{0};
+  static inline std::atomic<double> calibration_rate{0};
+  static inline std::atomic<int64_t> calibration_period{INT64_MAX};
+};
+
+inline constexpr char kDigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+ * * @brief Write value as exactly width decimal digits, zero padded.
+ */
+inline void WriteDigits(char* out, uint32_t value, int width) {
+  char* p = out + width;
+  while (width >= 2) {
+    p -= 2;
+    std::memcpy(p, kDigitPairs + (value % 100) * 2, 2);
+    value /= 100;
+    width -= 2;
+  }
+  if (width == 1) {
+    *--p = static_cast<char>('0' + value % 10);
+  }
+}
+
+/**
+ * * @brief Renders "YYYY-MM-DD HH:MM:SS[.fff[fff]]" in local time.
+ * * @details The calendar part is produced with localtime_r only when the
+ * second changes and is otherwise copied from a per-thread cache, so a busy
+ * thread pays for one calendar conversion per second instead of one per
+ * record. The fractional part comes straight from the time point.
+ */
+class TimestampCache {
+ public:
+  static constexpr size_t kSecondsLength = 19;
+  static constexpr size_t kMaxLength = kSecondsLength + 7;
+
+  /**
+   * * @param fraction_digits 0, 3 or 6.
+   * * @return The number of characters written to out (at most kMaxLength).
+   */
+  static size_t Format(std::chrono::system_clock::time_point time,
+                       int fraction_digits, char* out) {
+    auto seconds = std::chrono::floor<std::chrono::seconds>(time);
+    Entry& entry = Cached();
+    int64_t count = seconds.time_since_epoch().count();
+    if (entry.seconds != count) {
+      Render(count, entry.text);
+      entry.seconds = count;
+    }
+    std::memcpy(out, entry.text, kSecondsLength);
+    if (fraction_digits <= 0) {
+      return kSecondsLength;
+    }
+    auto micros =
+        std::chrono::duration_cast<std::chrono::microseconds>(time - seconds)
+            .count();
+    out[kSecondsLength] = '.';
+    if (fraction_digits <= 3) {
+      WriteDigits(out + kSecondsLength + 1,
+                  static_cast<uint32_t>(micros / 1000), 3);
+      return kSecondsLength + 4;
+    }
+    WriteDigits(out + kSecondsLength + 1, static_cast<uint32_t>(micros), 6);
+    return kSecondsLength + 7;
+  }
+
+ private:
+  struct Entry {
+    int64_t seconds{INT64_MIN};
+    char text[kSecondsLength];
+  };
+
+  static Entry& Cached() {
+    static thread_local Entry entry;
+    return entry;
+  }
+
+  static void Render(int64_t seconds, char* out) {
+    std::time_t time = static_cast<std::time_t>(seconds);
+    std::tm local{};
+    localtime_r(&time, &local);
+    WriteDigits(out, static_cast<uint32_t>(local.tm_year + 1900), 4);
+    out[4] = '-';
+    WriteDigits(out + 5, static_cast<uint32_t>(local.tm_mon + 1), 2);
+    out[7] = '-';
+    WriteDigits(out + 8, static_cast<uint32_t>(local.tm_mday), 2);
+    out[10] = ' ';
+    WriteDigits(out + 11, static_cast<uint32_t>(local.tm_hour), 2);
+    out[13] = ':';
+    WriteDigits(out + 14, static_cast<uint32_t>(local.tm_min), 2);
+    out[16] = ':';
+    WriteDigits(out + 17, static_cast<uint32_t>(local.tm_sec), 2);
+  }
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_TIME_H
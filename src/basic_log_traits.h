@@ -0,0 +1,146 @@
+#ifndef BASIC_LOG_TRAITS_H
+#define BASIC_LOG_TRAITS_H
+
+// Detection of the types the generic container overloads of operator<<
+// format: ranges, map-like ranges and tuple-like types that have no
+// std::ostream operator<< of their own.
+
+#include <cstddef>
+#include <iterator>
+#include <ostream>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace basic_log {
+namespace detail {
+
+template <typename T, typename = void>
+struct IsStreamable : std::false_type {};
+template <typename T>
+struct IsStreamable<T, std::void_t<decltype(std::declval<std::ostream&>()
+                                            << std::declval<const T&>())>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct IsRange : std::false_type {};
+template <typename T>
+struct IsRange<T, std::void_t<decltype(std::begin(std::declval<const T&>())),
+                              decltype(std::end(std::declval<const T&>()))>>
+    : std::true_type {};
+
+/// @brief A range of key-value pairs, e.g. std::multimap or a hash map.
+template <typename T, typename = void>
+struct IsMapLike : std::false_type {};
+template <typename T>
+struct IsMapLike<T, std::void_t<typename T::key_type, typename T::mapped_type,
+                                decltype(std::begin(std::declval<const T&>())
+                                             ->second)>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct IsTupleLike : std::false_type {};
+template <typename T>
+struct IsTupleLike<T, std::void_t<decltype(std::tuple_size<T>::value)>>
+    : std::true_type {};
+
+template <typename T, typename = void>
+struct HasSize : std::false_type {};
+template <typename T>
+struct HasSize<T, std::void_t<decltype(std::size(std::declval<const T&>()))>>
+    : std::true_type {};
+
+/// @brief A sized range whose elements std::data points to.
+template <typename T, typename = void>
+struct IsContiguous : std::false_type {};
+template <typename T>
+struct IsContiguous<
+    T, std::void_t<decltype(std::data(std::declval<const T&>())),
+                   decltype(std::size(std::declval<const T&>()))>>
+    : std::is_pointer<decltype(std::data(std::declval<const T&>()))> {};
+
+/// @brief Formatted element by element, as "name{ a , b }".
+template <typename T>
+inline constexpr bool kFormatsAsRange =
+    IsRange<T>::value && !IsStreamable<T>::value;
+
+/// @brief Formatted member by member, as "name{ a , b }".
+template <typename T>
+inline constexpr bool kFormatsAsTuple = IsTupleLike<T>::value &&
+                                        !IsRange<T>::value &&
+                                        !IsStreamable<T>::value;
+
+/**
+ * * @brief The name of the template T is a specialization of, e.g.
+ * "std::__cxx11::list", as the compiler spells it.
+ */
+template <typename T>
+constexpr std::string_view TemplateName() {
+#if defined(__clang__) || defined(__GNUC__)
+  // "... TemplateName() [with T = std::deque<int>; ...]" or "[T = ...]".
+  std::string_view name = __PRETTY_FUNCTION__;
+  name.remove_prefix(name.find("T = ") + 4);
+  return name.substr(0, name.find_first_of("<;]"));
+#elif defined(_MSC_VER)
+  // "... TemplateName<class std::deque<int,...> >(void)".
+  std::string_view name = __FUNCSIG__;
+  name.remove_prefix(name.find("TemplateName<") + 13);
+  for (std::string_view tag : {"class ", "struct "}) {
+    if (name.substr(0, tag.size()) == tag) {
+      name.remove_prefix(tag.size());
+    }
+  }
+  return name.substr(0, name.find_first_of("<>"));
+#else
+  return "container";
+#endif
+}
+
+/// @brief Text of at most N characters, built at compile time.
+template <size_t N>
+struct FixedName {
+  char text[N + 1]{};
+  size_t length{0};
+};
+
+/**
+ * * @brief name without the inline namespaces the standard libraries hide
+ * their containers in, "std::__cxx11::list" becoming "std::list".
+ */
+template <size_t N>
+constexpr FixedName<N> StripInlineNamespaces(std::string_view name) {
+  FixedName<N> result;
+  while (!name.empty()) {
+    size_t end = name.find("::");
+    std::string_view part = name.substr(0, end);
+    bool hidden = end != std::string_view::npos && part.size() > 2 &&
+                  part[0] == '_' && part[1] == '_';
+    if (!hidden) {
+      for (char c : name.substr(0, end == std::string_view::npos ? end
+                                                                 : end + 2)) {
+        result.text[result.length++] = c;
+      }
+    }
+    name = end == std::string_view::npos ? std::string_view()
+                                         : name.substr(end + 2);
+  }
+  return result;
+}
+
+template <typename T>
+inline constexpr auto kContainerNameText =
+    StripInlineNamespaces<TemplateName<T>().size()>(TemplateName<T>());
+
+/**
+ * * @brief The name records give T's values, e.g. "std::deque" or
+ * "absl::flat_hash_map"; a compile-time constant.
+ */
+template <typename T>
+inline constexpr std::string_view kContainerName{
+    kContainerNameText<T>.text, kContainerNameText<T>.length};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_TRAITS_H
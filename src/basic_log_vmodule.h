@@ -0,0 +1,148 @@
+#ifndef BASIC_LOG_VMODULE_H
+#define BASIC_LOG_VMODULE_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace basic_log {
+namespace detail {
+
+/**
+ * * @brief Whether text matches pattern, where '*' matches any run of
+ * characters and '?' any single one.
+ */
+inline bool GlobMatch(std::string_view pattern, std::string_view text) {
+  size_t p = 0;
+  size_t t = 0;
+  size_t star = std::string_view::npos;
+  size_t star_text = 0;
+  while (t < text.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+      ++p;
+      ++t;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_text = t;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      t = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
+/**
+ * * @brief Per-file level overrides, parsed from "pattern=LEVEL,...".
+ * * @details A pattern is matched against the source file without its
+ * extension: against the base name if the pattern has no '/', otherwise
+ * against the trailing path components, so "net/sock?t" matches
+ * "src/net/socket.cpp". The first matching rule wins.
+ */
+class VModule {
+ public:
+  /**
+   * * @param level_names The names of the levels, indexed by level.
+   * * @throws std::invalid_argument if spec is malformed.
+   */
+  template <size_t N>
+  static VModule Parse(std::string_view spec,
+                       const std::string_view (&level_names)[N]) {
+    VModule vmodule;
+    while (!spec.empty()) {
+      size_t comma = spec.find(',');
+      std::string_view entry = spec.substr(0, comma);
+      spec = comma == std::string_view::npos ? std::string_view()
+                                             : spec.substr(comma + 1);
+      entry = Trim(entry);
+      if (entry.empty()) {
+        continue;
+      }
+      size_t equals = entry.rfind('=');
+      if (equals == std::string_view::npos) {
+        throw std::invalid_argument("vmodule entry without a level: " +
+                                    std::string(entry));
+      }
+      std::string_view pattern = Trim(entry.substr(0, equals));
+      std::string_view name = Trim(entry.substr(equals + 1));
+      int level = -1;
+      for (size_t i = 0; i < N; ++i) {
+        if (level_names[i] == name) {
+          level = static_cast<int>(i);
+        }
+      }
+      if (pattern.empty() || level < 0) {
+        throw std::invalid_argument("invalid vmodule entry: " +
+                                    std::string(entry));
+      }
+      vmodule.rules.push_back({std::string(pattern), level});
+    }
+    return vmodule;
+  }
+
+  /// @return The level of the first rule matching path, or fallback.
+  int LevelFor(std::string_view path, int fallback) const {
+    if (rules.empty()) {
+      return fallback;
+    }
+    std::string_view stem = path;
+    size_t slash = stem.find_last_of("/\\");
+    size_t dot = stem.rfind('.');
+    if (dot != std::string_view::npos &&
+        (slash == std::string_view::npos || dot > slash)) {
+      stem = stem.substr(0, dot);
+    }
+    std::string_view base =
+        slash == std::string_view::npos ? stem : stem.substr(slash + 1);
+    for (const Rule& rule : rules) {
+      if (rule.pattern.find('/') == std::string::npos) {
+        if (GlobMatch(rule.pattern, base)) {
+          return rule.level;
+        }
+        continue;
+      }
+      // Try every suffix of the path that starts at a component.
+      for (size_t start = 0; start < stem.size();) {
+        if (GlobMatch(rule.pattern, stem.substr(start))) {
+          return rule.level;
+        }
+        size_t next = stem.find_first_of("/\\", start);
+        if (next == std::string_view::npos) {
+          break;
+        }
+        start = next + 1;
+      }
+    }
+    return fallback;
+  }
+
+ private:
+  struct Rule {
+    std::string pattern;
+    int level;
+  };
+
+  static std::string_view Trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+      text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+      text.remove_suffix(1);
+    }
+    return text;
+  }
+
+  std::vector<Rule> rules;
+};
+
+}  // namespace detail
+}  // namespace basic_log
+
+#endif  // BASIC_LOG_VMODULE_H
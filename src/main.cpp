@@ -1,6 +1,7 @@
 #include "basic_log.h"
 
 #include <chrono>
+#include <string_view>
 
 using namespace std::chrono_literals;
 
@@ -16,33 +17,39 @@ int main(int argc, char const *argv[]) {
 
   LOG(ERROR) << "This is an error message" << std::make_pair(1, 2);
 
-  LOG(FATAL) << "This is a fatal message"
+  LOG(ERROR) << "This is an error message"
              << std::map<std::string, int>{{"key1", 1}, {"key2", 2}};
 
-  LOG(FATAL) << "This is a fatal message" << std::set<int>{1, 2, 3};
+  LOG(ERROR) << "This is an error message" << std::set<int>{1, 2, 3};
 
-  LOG(FATAL) << "This is a fatal message"
+  LOG(ERROR) << "This is an error message"
              << std::unordered_map<std::string, int>{{"key1", 1}, {"key2", 2}};
-  LOG(FATAL) << "This is a fatal message" << std::optional<int>{std::nullopt};
-  LOG(FATAL) << "This is a fatal message" << std::optional<int>{42};
-  LOG(FATAL) << "This is a fatal message"
+  LOG(ERROR) << "This is an error message" << std::optional<int>{std::nullopt};
+  LOG(ERROR) << "This is an error message" << std::optional<int>{42};
+  LOG(ERROR) << "This is an error message"
              << std::optional<std::string>{"Hello, World!"};
 
-  LOG(FATAL) << "This is a fatal message" << 1s;
+  LOG(ERROR) << "This is an error message" << 1s;
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::milliseconds(1000);
+    LOG(ERROR) << "This is an error message" << std::chrono::milliseconds(1000);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::microseconds(1000);
+    LOG(ERROR) << "This is an error message" << std::chrono::microseconds(1000);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::nanoseconds(1000);
+    LOG(ERROR) << "This is an error message" << std::chrono::nanoseconds(1000);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::hours(1);
+    LOG(ERROR) << "This is an error message" << std::chrono::hours(1);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::minutes(1);
+    LOG(ERROR) << "This is an error message" << std::chrono::minutes(1);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::seconds(1);
+    LOG(ERROR) << "This is an error message" << std::chrono::seconds(1);
 
-    LOG(FATAL) << "This is a fatal message" << std::chrono::system_clock::now();
+    LOG(ERROR) << "This is an error message"
+               << std::chrono::system_clock::now();
+
+  if (argc > 1 && std::string_view(argv[1]) == "--fatal") {
+    // Flushes everything logged so far, then aborts the program.
+    LOG(FATAL) << "This is a fatal message";
+  }
 
   return 0;
 }